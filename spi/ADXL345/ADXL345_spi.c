@@ -1,11 +1,32 @@
 #include "ADXL345_spi.h"
+#include "stats.h"
+#include "stream.h"
+#include "decimate.h"
+#include "timestamp.h"
+#include "calibration.h"
+#include "capture.h"
 #include "interrupts.h"
+#include "pm.h"
 #include "interface.h"
+#include "iio.h"
 /* META INFO */
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Decryptec");
 MODULE_DESCRIPTION("ADXL345 driver using cdev, sysfs, and Interrupt");
 
+// Last reference gone: the unbind and the last close of any of its char devices
+static void adxl_kobj_release(struct kobject *kobj) {
+    kfree(container_of(kobj, struct my_ADXL345, kobj));
+}
+
+static const struct kobj_type adxl_ktype = {
+    .release = adxl_kobj_release,
+};
+
+static void adxl_devm_put(void *adxl) {
+    kobject_put(&((struct my_ADXL345 *)adxl)->kobj);
+}
+
 // SPI probe
 static int adxl345_probe(struct spi_device *spi) {
     struct my_ADXL345 *adxl;
@@ -15,17 +36,29 @@ static int adxl345_probe(struct spi_device *spi) {
 
     // dev_info(&spi->dev, "Probing ADXL345\n"); // Minimal: can be enabled for debug
 
-    // Allocate and initialize device structure
-    adxl = devm_kzalloc(&spi->dev, sizeof(*adxl), GFP_KERNEL);
+    // Allocate and initialize device structure, refcounted: open files can outlive the unbind
+    adxl = kzalloc(sizeof(*adxl), GFP_KERNEL);
     if (!adxl) return -ENOMEM;
+    kobject_init(&adxl->kobj, &adxl_ktype);
+    ret = devm_add_action_or_reset(&spi->dev, adxl_devm_put, adxl);
+    if (ret) return ret;
+    mutex_init(&adxl->file_lock);
 
     adxl->spi = spi;
     adxl->dev = &spi->dev;
+    adxl->stats = devm_alloc_percpu(&spi->dev, struct adxl_stats);
+    if (!adxl->stats) return -ENOMEM;
     spi_set_drvdata(spi, adxl);
     mutex_init(&adxl->lock);
+    spin_lock_init(&adxl->data_lock);
     adxl->irq = -1;
     adxl->int1_gpio = -1;
-    adxl->last_double_tap_jiffies = jiffies - msecs_to_jiffies(DOUBLE_TAP_COOLDOWN_MS * 2);
+    adxl->double_tap_cooldown_ms = DOUBLE_TAP_COOLDOWN_MS;
+    adxl->decimation = 1;
+    spin_lock_init(&adxl->capture_lock);
+    adxl->capture_pre_ms = CAPTURE_PRE_MS_DEFAULT;
+    adxl->capture_post_ms = CAPTURE_POST_MS_DEFAULT;
+    adxl->capture_triggers = CAPTURE_TRIGGERS_DEFAULT;
 
     // Configure SPI bus parameters for this device
     spi->mode = SPI_MODE_3;
@@ -37,8 +70,14 @@ static int adxl345_probe(struct spi_device *spi) {
     }
     // dev_info(adxl->dev, "SPI mode:0x%x, speed:%dHz\n", spi->mode, spi->max_speed_hz); 
 
+    adxl->regmap = devm_regmap_init_spi(spi, &adxl345_regmap_config);
+    if (IS_ERR(adxl->regmap)) {
+	    dev_err(adxl->dev, "regmap init failed: %ld\n", PTR_ERR(adxl->regmap));
+	    return PTR_ERR(adxl->regmap);
+    }
+
     // Verify Device ID
-    ret = read_reg(spi, REG_DEVID, &devid);
+    ret = read_reg(adxl, REG_DEVID, &devid);
     if (ret) {
 	    dev_err(adxl->dev, "Read REG_DEVID failed: %d\n", ret);
 	    return ret;
@@ -51,35 +90,78 @@ static int adxl345_probe(struct spi_device *spi) {
 
     // Initialize ADXL345 core operational registers
     // dev_info(adxl->dev, "Initializing ADXL345 core registers...\n");
-    ret = write_reg(spi, REG_POWER_CTL, POWER_CTL_MEASURE); 
+    ret = write_reg(adxl, REG_POWER_CTL, POWER_CTL_MEASURE); 
     if (ret) {
 	    return ret;
     }
-    data_format_val = 0x0B; adxl->range = 16; // +/-16g, Full Res
-    ret = write_reg(spi, REG_DATA_FORMAT, data_format_val); 
+    data_format_val = DATA_FORMAT_FULL_RES | 0x03; adxl->range = 16; // +/-16g, Full Res
+    ret = write_reg(adxl, REG_DATA_FORMAT, data_format_val); 
     if (ret) {
 	    return ret;
     }
-    bw_rate_val = 0x0A; adxl->rate = 100;     // 100Hz ODR
-    ret = write_reg(spi, REG_BW_RATE, bw_rate_val); 
+    bw_rate_val = 0x0A; adxl->bw_rate = bw_rate_val; // 100Hz ODR
+    ret = write_reg(adxl, REG_BW_RATE, bw_rate_val); 
     if (ret) {
 	    return ret;
 	}
+    adxl->power_ctl = POWER_CTL_MEASURE;
+    ret = offsets_init(adxl, spi);
+    if (ret) {
+	    return ret;
+    }
 
     ret = interrupt_init(adxl, spi);
     if (ret) { 
 	    dev_err(adxl->dev, "Failed to initialize Interrupts: %d\n", ret); 
+	    interrupts_cleanup(adxl, spi); // The IRQ may be live already
 	    return ret;
     }
 
+    // Active until probe is done, then standby until the first reader opens a device
+    pm_runtime_get_noresume(adxl->dev);
+    pm_runtime_set_active(adxl->dev);
+    pm_runtime_set_autosuspend_delay(adxl->dev, ADXL_AUTOSUSPEND_MS);
+    pm_runtime_use_autosuspend(adxl->dev);
+    pm_runtime_enable(adxl->dev);
+
     ret = interface_init(adxl, spi);
     if (ret) { 
 	    dev_err(adxl->dev, "Failed to initialize interfaces: %d\n", ret); 
-	    return ret; 
+	    goto err_irq;
     }
 
+    ret = iio_init(adxl, spi);
+    if (ret) {
+	    dev_err(adxl->dev, "Failed to initialize IIO device: %d\n", ret);
+	    goto err_interface;
+    }
+
+    ret = interrupts_arm(adxl); // Streams and IIO are ready for the completion now
+    if (ret) {
+	    dev_err(adxl->dev, "Failed to enable interrupts: %d\n", ret);
+	    iio_cleanup(adxl);
+	    goto err_interface;
+    }
+    stats_init(adxl);
+    adxl_pm_put(adxl);
+
     dev_info(adxl->dev, "ADXL345 driver initialized successfully\n"); 
     return 0;
+
+// Bursts complete asynchronously into adxl and the streams: stop and drain them before
+// anything they touch goes away
+err_interface:
+    interrupts_cleanup(adxl, spi);
+    interface_cleanup(adxl, spi);
+    goto err_pm;
+err_irq:
+    interrupts_cleanup(adxl, spi);
+err_pm:
+    pm_runtime_disable(adxl->dev);
+    pm_runtime_dont_use_autosuspend(adxl->dev);
+    pm_runtime_set_suspended(adxl->dev);
+    pm_runtime_put_noidle(adxl->dev);
+    return ret;
 }
 
 // SPI remove function
@@ -93,11 +175,33 @@ static void adxl345_remove(struct spi_device *spi) {
         return;
     }
 
-    interface_cleanup(adxl, spi);
+    // Open files fail from here on, their runtime PM references are dropped below
+    mutex_lock(&adxl->file_lock);
+    mutex_lock(&adxl->lock);
+    adxl->dead = true;
+    mutex_unlock(&adxl->lock);
+
+    // Keep the sensor awake for the teardown below, no more runtime PM transitions
+    pm_runtime_get_sync(adxl->dev);
+    iio_cleanup(adxl); // Stops a running buffer while the FIFO can still be reconfigured
+    pm_runtime_disable(adxl->dev);
+    pm_runtime_dont_use_autosuspend(adxl->dev);
+    if (adxl->capture_pm)
+        pm_runtime_put_noidle(adxl->dev);
+    for (; adxl->pm_users; adxl->pm_users--)
+        pm_runtime_put_noidle(adxl->dev);
+    mutex_unlock(&adxl->file_lock);
+    pm_runtime_put_noidle(adxl->dev);
+    pm_runtime_set_suspended(adxl->dev);
 
     // Disable Interrupts on ADXL345 (best effort)
-    // Do this before freeing IRQ in case an interrupt is pending
+    // Do this before freeing IRQ in case an interrupt is pending, and before the
+    // streams the interrupt completion feeds are torn down
     interrupts_cleanup(adxl, spi);
+
+    interface_cleanup(adxl, spi);
+    capture_cleanup(adxl);
+    stats_cleanup(adxl);
     // IRQ and GPIO are managed by devm_* functions, no explicit free needed here
     dev_info(&spi->dev, "ADXL345 driver removed successfully\n");
 }
@@ -123,6 +227,7 @@ static struct spi_driver adxl345_driver = {
     .driver = {
         .name = "adxl345_custom", 
         .of_match_table = adxl345_of_match, // For DT probing
+        .pm = pm_ptr(&adxl345_pm_ops),
         .owner = THIS_MODULE,
     },
 };
@@ -18,6 +18,31 @@
 #include <linux/kobject.h>
 #include <linux/sysfs.h>
 #include <linux/jiffies.h> // For jiffies, msecs_to_jiffies, time_before
+#include <linux/spinlock.h>
+#include <linux/bitops.h>
+#include <linux/wait_bit.h> // For wait_var_event, wake_up_var
+#include <linux/timekeeping.h> // For ktime_get_ns
+#include <linux/math64.h>
+#include <linux/ctype.h>
+#include <linux/kfifo.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/mm.h> // For kvcalloc, kvfree
+#include <linux/pm_runtime.h>
+#include <linux/log2.h>
+#include <linux/regmap.h>
+#include <linux/irq_work.h>
+#include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/sysfs.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+#include "adxl345_uapi.h"
 
 // ADXL345 Register Definitions
 #define REG_DEVID 0x00
@@ -28,12 +53,46 @@
 #define REG_INT_ENABLE 0x2E
 #define REG_INT_SOURCE 0x30
 #define REG_INT_MAP 0x2F
+#define REG_THRESH_ACT 0x24   // Activity threshold, 62.5 mg/LSB
+#define REG_THRESH_INACT 0x25 // Inactivity threshold, 62.5 mg/LSB
+#define REG_TIME_INACT 0x26   // Inactivity time, 1 s/LSB
+#define REG_ACT_INACT_CTL 0x27
+#define REG_OFSX 0x1E // Offsets X/Y/Z (0x1E-0x20), 15.6 mg/LSB, two's complement
+#define REG_ACT_TAP_STATUS 0x2B
+#define REG_FIFO_CTL 0x38
+#define REG_FIFO_STATUS 0x39
+#define REG_MAX REG_FIFO_STATUS
 
 // ADXL345 Register Bit Definitions
 #define POWER_CTL_MEASURE 0x08 // Set Measure bit to start measuring
+#define POWER_CTL_LINK 0x20 // Serialise activity and inactivity detection
+#define POWER_CTL_AUTO_SLEEP 0x10 // Sleep at the wakeup rate after inactivity (needs LINK)
+#define POWER_CTL_WAKEUP_8HZ 0x00 // Sampling rate while asleep
+#define DATA_FORMAT_FULL_RES 0x08
+#define DATA_FORMAT_RANGE_MASK 0x03 // +/-2g, 4g, 8g, 16g
+#define ACT_INACT_CTL_ALL_AC 0xFF // AC coupled activity and inactivity on X, Y and Z
+#define ADXL_AUTOSUSPEND_MS 1000 // Standby this long after the last reader closes
 #define INT_DATA_READY 0x80 // Data Ready Interrupt Enable
 #define INT_SINGLE_TAP 0x40 // Single Tap Interrupt Enable
 #define INT_DOUBLE_TAP 0x20 // Double Tap Interrupt Enable
+#define INT_ACTIVITY 0x10 // Activity Interrupt Enable
+#define INT_INACTIVITY 0x08 // Inactivity Interrupt Enable
+#define INT_FREE_FALL 0x04 // Free-Fall Interrupt Enable
+#define INT_WATERMARK 0x02 // FIFO holds FIFO_CTL samples entries
+#define INT_OVERRUN 0x01 // Data (or FIFO entries) overwritten before being read
+#define FIFO_CTL_BYPASS 0x00
+#define FIFO_CTL_STREAM 0x80 // Keep the newest 32 entries, oldest are overwritten
+#define FIFO_CTL_SAMPLES_MASK 0x1F // Watermark level
+#define BW_RATE_LOW_POWER 0x10 // Reduced power, higher noise (12.5Hz - 400Hz only)
+#define BW_RATE_RATE_MASK 0x0F
+
+// Output data rates in mHz, indexed by the BW_RATE rate code
+static const unsigned int adxl345_odr_mhz[] = {
+    100, 200, 390, 780, 1560, 3130, 6250, 12500,
+    25000, 50000, 100000, 200000, 400000, 800000, 1600000, 3200000,
+};
+#define ODR_LOW_POWER_MIN 0x07 // 12.5Hz, lowest rate code with low power support
+#define ODR_LOW_POWER_MAX 0x0C // 400Hz, highest rate code with low power support
 
 // Tap config
 #define REG_THRESH_TAP    0x1D // Tap threshold
@@ -41,21 +100,199 @@
 #define REG_LATENT        0x22 // Tap latency (for double tap)
 #define REG_WINDOW        0x23 // Tap window (for double tap)
 #define REG_TAP_AXES      0x2A // Axis control for single tap/double tap
-#define DOUBLE_TAP_COOLDOWN_MS 1000 // Cooldown period in milliseconds
+#define DOUBLE_TAP_COOLDOWN_MS 1000 // Default single tap suppression after a double tap
+// Activity/inactivity defaults
+#define THRESH_ACT_DEFAULT 0x04   // 250 mg
+#define THRESH_INACT_DEFAULT 0x03 // 187.5 mg
+#define TIME_INACT_DEFAULT 5      // 5 s still before sleeping
+
+// Pre-trigger capture
+#define CAPTURE_MAX_SAMPLES 4096 // 1.28 s at 3200 Hz, 64 KiB
+#define CAPTURE_OFF 0
+#define CAPTURE_ARMED 1     // Recording the pre-trigger window
+#define CAPTURE_TRIGGERED 2 // Recording the post-trigger window
+#define CAPTURE_READY 3     // Frozen until re-armed
+#define CAPTURE_PRE_MS_DEFAULT 500
+#define CAPTURE_POST_MS_DEFAULT 500
+#define CAPTURE_TRIGGERS_DEFAULT (BIT(ADXL345_EV_DOUBLE_TAP) | BIT(ADXL345_EV_ACTIVITY) | \
+                                  BIT(ADXL345_EV_THRESHOLD))
+
+// Offset calibration
+#define CAL_ONE_G_LSB 256  // 1g in full resolution counts (3.9 mg/LSB)
+#define CAL_SAMPLES_MAX 1000
+#define CAL_TIME_MAX_MS 5000 // adxl->lock is held while sampling, keep it short
+
+// Record streams: minor numbers and queue depths (powers of 2)
+#define ADXL_MINOR_DATA 0    // /dev/adxl345 text interface
+#define ADXL_MINOR_EVENTS 1  // /dev/adxl345_events
+#define ADXL_MINOR_SAMPLES 2 // /dev/adxl345_samples, decimated
+#define ADXL_MINOR_RAW 3     // /dev/adxl345_raw, full rate
+#define ADXL_MINORS 4
+#define EVENT_FIFO_SIZE 64
+#define SAMPLE_FIFO_SIZE 1024
+#define RAW_FIFO_SIZE 4096 // 1.28 s at 3200 Hz
+#define DECIMATION_MAX 1024
+
+// Interrupt burst: one multi-byte read from INT_SOURCE (0x30) through DATAZ1 (0x37)
+// rx[0] = dummy (command slot), rx[1] = INT_SOURCE, rx[2] = DATA_FORMAT, rx[3..8] = X0..Z1
+#define IRQ_BURST_LEN 9
+#define IRQ_BURST_INT_SOURCE 1
+#define IRQ_BURST_DATA 3
+
+// FIFO drain after a watermark interrupt: the burst popped the oldest entry, each further
+// entry is its own 6 byte DATAX0..DATAZ1 read with CS released and 5 us between reads
+#define FIFO_WATERMARK_MAX 31 // FIFO_CTL samples field
+#define FIFO_ENTRY_LEN 7 // Command slot + DATAX0..DATAZ1
+#define FIFO_POP_DELAY_US 5
+#define IIO_FIFO_SIZE 64 // Samples staged between the completion and the IIO pollfunc
+
+// irq_flags bits
+#define ADXL_XFER_BUSY 0    // Burst message owned by the SPI core
+#define ADXL_XFER_PENDING 1 // Another burst requested while busy
+#define ADXL_XFER_STOP 2    // Driver removal: no new bursts
+#define ADXL_TS_FRESH 3     // irq_ts holds an INT1 edge not yet taken by a burst
 
 #define DEVICE_NAME "adxl345"
 #define CLASS_NAME "adxl345_class"
 
+struct my_ADXL345;
+
+// One record stream char device (stream.h)
+struct adxl_stream {
+    struct my_ADXL345 *adxl;
+    struct kfifo fifo;
+    unsigned int rec_size;
+    wait_queue_head_t wq;
+    struct mutex read_lock; // Serialises readers, kfifo is single consumer
+    atomic_t users; // Open file handles
+    u32 dropped;
+    struct cdev cdev;
+    dev_t devt;
+};
+
+// Per-CPU statistics (stats.h)
+#define STATS_HIST_BUCKETS 16 // Power of two microsecond buckets: <1us, <2us, ... >=16ms
+struct adxl_stats {
+    u64 irqs;
+    u64 empty_irqs;    // INT_SOURCE read back as 0
+    u64 samples;
+    u64 fifo_overruns; // OVERRUN in INT_SOURCE: the sensor overwrote unread data
+    u64 ring_overruns; // A software queue (stream, IIO staging) was full
+    u64 spi_errors;
+    u32 latency_hist[STATS_HIST_BUCKETS]; // INT1 edge to sample data in hand
+    u32 xfer_hist[STATS_HIST_BUCKETS];    // Interrupt path SPI message, submit to completion
+};
+
+// Count one event (any context)
+#define adxl_stat_inc(adxl, field) this_cpu_inc((adxl)->stats->field)
+
 // Device struct
 struct my_ADXL345 {
+    // Parent of the cdevs: open files keep the struct past the unbind (a kref can't, the
+    // last cdev_put() runs after release). Probe holds one reference.
+    struct kobject kobj;
+    struct mutex file_lock; // Open files' runtime PM references and dead
+    unsigned int pm_users;  // Open files holding a runtime PM reference
+    bool dead; // Unbound: only the struct and the wait queues are left (file_lock and lock)
     struct spi_device *spi;
+    struct regmap *regmap; // Cached config registers, data/INT_SOURCE/FIFO are volatile
     struct device *dev;
     struct mutex lock;
     int irq; // IRQ Num
     int16_t x;
     int16_t y;
     int16_t z;
-    unsigned long last_double_tap_jiffies;
+    spinlock_t data_lock; // Protects x/y/z, written from SPI completion context
+    u64 last_double_tap_ns;
+    unsigned int double_tap_cooldown_ms;
+
+    // Record streams, fed by the interrupt completion
+    struct adxl_stream events;
+    struct adxl_stream samples; // Decimated by "decimation"
+    struct adxl_stream raw;     // Full ODR, only filled while open
+
+    // Averaging decimator in front of the samples stream (completion context)
+    u32 decimation;
+    u32 dec_count;
+    s32 dec_sum[3];
+    u64 dec_first_ns;
+
+    // Activity/inactivity auto sleep
+    bool auto_sleep;
+    bool idle; // Inactivity seen, DATA_READY masked until activity
+    u8 int_enable; // Cached INT_ENABLE register (applied while active)
+    u8 data_int;   // Data interrupt in use: INT_DATA_READY, or INT_WATERMARK in FIFO mode
+    u8 power_ctl;  // Cached POWER_CTL register (applied while active)
+    bool suspended; // Runtime suspended: standby, interrupts masked (under adxl->lock)
+    bool capture_pm; // Armed capture holds a runtime PM reference
+    struct work_struct power_work; // Applies idle/wake INT_ENABLE changes
+    u64 idle_since_ns;
+    u64 idle_total_ns;
+    u64 avoided_irqs; // DATA_READY interrupts not taken while idle
+    u32 sleep_count;
+
+    // Pre-trigger capture (capture.h), ring state under capture_lock
+    spinlock_t capture_lock;
+    struct adxl345_sample *capture_buf; // CAPTURE_MAX_SAMPLES, allocated on first arm
+    u32 capture_len;  // Ring size: pre + post samples
+    u32 capture_head; // Next slot to write
+    u32 capture_fill; // Valid samples in the ring
+    u32 capture_post; // Samples to record after the trigger
+    u32 capture_post_done;
+    int capture_state;
+    struct adxl345_capture_header capture_hdr;
+    u32 capture_pre_ms;
+    u32 capture_post_ms;
+    u32 capture_threshold_mg; // Magnitude trigger, 0 = off
+    u32 capture_triggers; // BIT(ADXL345_EV_*) mask
+
+    // Statistics (stats.h)
+    struct adxl_stats __percpu *stats;
+    struct dentry *debugfs;
+
+    // Interrupt path (hard IRQ -> spi_async -> completion)
+    struct spi_message irq_msg;
+    struct spi_transfer irq_xfer;
+    unsigned long irq_flags;
+    u64 irq_ts;   // ktime_get_ns() of the last INT1 edge, taken in the hard IRQ
+    u64 burst_ts; // Edge time for the current burst (or submit time if no new edge)
+    bool burst_fresh; // Current burst was started by a new edge
+    u64 burst_submit_ns; // spi_async() time of the burst and of the FIFO drain
+    u64 fifo_submit_ns;
+
+    // Hardware FIFO (stream mode while the IIO buffer runs with a watermark > 1)
+    u8 fifo_watermark; // Active watermark, 0 = bypass
+    u8 hw_watermark;   // Requested by the IIO core, applied on buffer enable
+    unsigned int fifo_n; // Entries in the current drain, entry 0 comes from the burst
+    struct spi_message fifo_msg;
+    struct spi_transfer fifo_xfer[FIFO_WATERMARK_MAX]; // [0] is the pop delay
+
+    // IIO device (iio.h): samples are staged by the completion and pushed by the pollfunc
+    struct iio_dev *indio_dev;
+    struct iio_trigger *iio_trig;
+    struct irq_work iio_work; // Fires the data-ready trigger from hard IRQ context
+    DECLARE_KFIFO(iio_fifo, struct adxl345_sample, IIO_FIFO_SIZE);
+    bool iio_active; // Buffer enabled, stage samples
+    struct {
+        s16 chan[3];
+        s64 ts __aligned(8);
+    } iio_scan;
+
+    // Per-sample timestamp estimator (timestamp.h), under data_lock
+    u64 ts_nominal_q; // Nominal sample period, ns << TS_Q
+    u64 ts_period_q;  // Estimated real sample period, ns << TS_Q
+    u64 ts_anchor_ns; // Start of the current period measurement window
+    u64 ts_edge_ns;   // Previous INT1 edge
+    u64 ts_last_ns;   // Stamp of the newest sample handed out
+    u32 ts_pending;   // Samples received since ts_edge_ns without a new edge
+    u64 ts_win_samples; // Samples the sensor produced in the current window
+    u64 ts_missed;    // Samples the sensor produced that never reached us
+    bool ts_reset;
+
+    // Measured data rate from DATA_READY timestamps (completion context only)
+    u64 meas_start_ns;
+    u32 meas_count;
+    u32 measured_mhz;
 
     //Char device members
     dev_t dev_num;
@@ -64,136 +301,150 @@ struct my_ADXL345 {
 
     //Configuration (Sysfs interface)
     int range;
-    int rate;
+    u8 bw_rate; // Cached BW_RATE register: rate code | LOW_POWER
+    s8 offset[3]; // Cached OFSX/OFSY/OFSZ
+    bool low_power; // Low power requested, applied when the ODR allows it
     int int1_gpio;
+
+    // DMA-safe buffers for the interrupt burst, keep last in the struct
+    u8 irq_tx[IRQ_BURST_LEN] ____cacheline_aligned;
+    u8 irq_rx[IRQ_BURST_LEN] ____cacheline_aligned;
+    u8 fifo_tx[FIFO_ENTRY_LEN] ____cacheline_aligned;
+    u8 fifo_rx[FIFO_WATERMARK_MAX][FIFO_ENTRY_LEN] ____cacheline_aligned;
+};
+
+// Register map: configuration registers are cached, so reads and read-modify-write updates
+// cost no bus traffic. Data, status and FIFO registers change under us and are volatile.
+static bool adxl345_readable_reg(struct device *dev, unsigned int reg) {
+    return reg == REG_DEVID || (reg >= REG_THRESH_TAP && reg <= REG_MAX);
+}
+
+static bool adxl345_writeable_reg(struct device *dev, unsigned int reg) {
+    return reg >= REG_THRESH_TAP && reg <= REG_FIFO_CTL &&
+           reg != REG_ACT_TAP_STATUS && reg != REG_INT_SOURCE;
+}
+
+static bool adxl345_volatile_reg(struct device *dev, unsigned int reg) {
+    switch (reg) {
+    case REG_ACT_TAP_STATUS:
+    case REG_INT_SOURCE:
+    case REG_DATAX0 ... REG_DATAX0 + 5: // DATAX0..DATAZ1
+    case REG_FIFO_STATUS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static const struct regmap_config adxl345_regmap_config = {
+    .reg_bits = 8,
+    .val_bits = 8,
+    .read_flag_mask = 0x80 | 0x40, // Read, multi-byte (needed for bulk reads, harmless otherwise)
+    .max_register = REG_MAX,
+    .readable_reg = adxl345_readable_reg,
+    .writeable_reg = adxl345_writeable_reg,
+    .volatile_reg = adxl345_volatile_reg,
+    .cache_type = REGCACHE_MAPLE,
 };
 
 // Helper functions
-static int read_reg(struct spi_device *spi, uint8_t reg, uint8_t *val) {
+static int read_reg(struct my_ADXL345 *adxl, uint8_t reg, uint8_t *val) {
+    unsigned int v;
     int ret;
-    
-    // Simple helper function approach
-    ret = spi_w8r8(spi, reg | 0x80);
-    if (ret < 0)
-    {
-        dev_err(&spi->dev, "Failed to read REG 0x%02x: Error: %d\n", reg, ret);
-        return ret;
-    }
-    *val = (u8)ret;
-    /* Optional: Explicit approach
-    //u8 tx_buf[2], rx_buf[2];
-    tx_buf[0] = reg | 0x80; // Read (MSB = 1)
-    tx_buf[1] = 0x00;       // Dummy byte for clocking
-
-    struct spi_transfer xfer = {
-        .tx_buf = tx_buf,
-        .rx_buf = rx_buf,
-        .len = 2,
-        .delay.value = 5,
-        .delay.unit = SPI_DELAY_UNIT_USECS,
-    };
-
-    struct spi_message msg;
-    spi_message_init(&msg);
-    spi_message_add_tail(&xfer, &msg);
-
-    ret = spi_sync(spi, &msg);
+
+    ret = regmap_read(adxl->regmap, reg, &v);
     if (ret) {
-        dev_err(&spi->dev, "SPI read_reg (0x%02x) failed: %d\n", reg, ret);
+        adxl_stat_inc(adxl, spi_errors);
+        dev_err(adxl->dev, "Failed to read REG 0x%02x: Error: %d\n", reg, ret);
         return ret;
     }
-
-    *val = rx_buf[1]; // Data is in the second byte received
-    */
+    *val = v;
     return 0;
 }
 
-static int write_reg(struct spi_device *spi, uint8_t reg, uint8_t val) {
+static int write_reg(struct my_ADXL345 *adxl, uint8_t reg, uint8_t val) {
     int ret;
 
-    // Simple helper function approach
-    u8 tx_buf[2] = {reg & ~0x80, val};
-    ret = spi_write(spi, tx_buf, 2);
+    ret = regmap_write(adxl->regmap, reg, val);
     if (ret) {
-        dev_err(&spi->dev, "Failed to write to REG 0x%02x: Error: %d\n", reg, ret);
-        return ret;
+        adxl_stat_inc(adxl, spi_errors);
+        dev_err(adxl->dev, "Failed to write to REG 0x%02x: Error: %d\n", reg, ret);
     }
-    /* Optional: Explicit Approach
-    //u8 tx_buf[2];
-    tx_buf[0] = reg & ~0x80; // Write (MSB = 0)
-    tx_buf[1] = val;
-
-    struct spi_transfer xfer = {
-        .tx_buf = tx_buf,
-        .len = 2,
-        .delay.value = 5,
-        .delay.unit = SPI_DELAY_UNIT_USECS,
-    };
-
-    struct spi_message msg;
-    spi_message_init(&msg);
-    spi_message_add_tail(&xfer, &msg);
-
-    ret = spi_sync(spi, &msg);
+    return ret;
+}
+
+// Change only the bits in mask, from the cache (no bus read). Skipped if nothing changes.
+static int update_reg(struct my_ADXL345 *adxl, uint8_t reg, uint8_t mask, uint8_t val) {
+    int ret;
+
+    ret = regmap_update_bits(adxl->regmap, reg, mask, val);
     if (ret) {
-        dev_err(&spi->dev, "SPI write_reg (0x%02x with 0x%02x) failed: %d\n", reg, val, ret);
-        return ret;
+        adxl_stat_inc(adxl, spi_errors);
+        dev_err(adxl->dev, "Failed to update REG 0x%02x: Error: %d\n", reg, ret);
     }
-    */
-    return 0;
+    return ret;
 }
 
-// Get acceleration data
-static int get_data(struct my_ADXL345 *adxl) {
-    int ret;
-    u8 tx_buf[7], rx_buf[7];
+// Runtime PM references: held by every open file and by an armed capture (pm.h)
+static int adxl_pm_get(struct my_ADXL345 *adxl) {
+    return pm_runtime_resume_and_get(adxl->dev);
+}
+
+static void adxl_pm_put(struct my_ADXL345 *adxl) {
+    pm_runtime_mark_last_busy(adxl->dev);
+    pm_runtime_put_autosuspend(adxl->dev);
+}
+
+// Open files: remove drops the references of those still open and marks the device dead,
+// their release then has nothing left to put
+static int adxl_file_get(struct my_ADXL345 *adxl) {
+    int ret = -ENODEV;
 
-    if (!adxl || !adxl->spi) return -ENODEV; // Sanity check
+    mutex_lock(&adxl->file_lock);
+    if (!adxl->dead) {
+        ret = adxl_pm_get(adxl);
+        if (!ret)
+            adxl->pm_users++;
+    }
+    mutex_unlock(&adxl->file_lock);
+    return ret;
+}
+
+static void adxl_file_put(struct my_ADXL345 *adxl) {
+    mutex_lock(&adxl->file_lock);
+    if (!adxl->dead) {
+        adxl->pm_users--;
+        adxl_pm_put(adxl);
+    }
+    mutex_unlock(&adxl->file_lock);
+}
 
-    tx_buf[0] = REG_DATAX0 | 0x80 | 0x40; // Multi-byte read starting at DATAX0
-    memset(&tx_buf[1], 0, 6);           // Dummy bytes
+// Store one DATAX0..DATAZ1 sample, safe from any context
+static void store_sample(struct my_ADXL345 *adxl, const u8 *raw) {
+    unsigned long flags;
 
-    struct spi_transfer xfer = {
-        .tx_buf = tx_buf,
-        .rx_buf = rx_buf,
-        .len = 7,
-        .delay.value = 5,
-        .delay.unit = SPI_DELAY_UNIT_USECS,
-    };
+    spin_lock_irqsave(&adxl->data_lock, flags);
+    adxl->x = (s16)((raw[1] << 8) | raw[0]); // Use s16 for signed 16-bit
+    adxl->y = (s16)((raw[3] << 8) | raw[2]);
+    adxl->z = (s16)((raw[5] << 8) | raw[4]);
+    spin_unlock_irqrestore(&adxl->data_lock, flags);
+}
 
-    struct spi_message msg;
-    spi_message_init(&msg);
-    spi_message_add_tail(&xfer, &msg);
+// Get acceleration data
+static int get_data(struct my_ADXL345 *adxl) {
+    u8 raw[6];
+    int ret;
 
-    dev_dbg(&adxl->spi->dev, "GET_DATA: Calling spi_sync...\n");
-    ret = spi_sync(adxl->spi, &msg);
-    dev_dbg(&adxl->spi->dev, "GET_DATA: spi_sync returned %d\n", ret);
+    if (!adxl || !adxl->regmap) return -ENODEV; // Sanity check
 
+    ret = regmap_bulk_read(adxl->regmap, REG_DATAX0, raw, sizeof(raw)); // DATAX0..DATAZ1
     if (ret) {
-        dev_err(&adxl->spi->dev, "SPI Acceleration read failed in get_data: %d\n", ret);
+        adxl_stat_inc(adxl, spi_errors);
+        dev_err(adxl->dev, "SPI Acceleration read failed in get_data: %d\n", ret);
         return ret;
     }
 
-    // Print raw buffer only if spi_sync was okay
-    int i;
-    char temp_buf[7 * 6]; // Adjusted size for "0xXX " format, and safety
-    char *ptr = temp_buf;
-    temp_buf[0] = '\0'; // Ensure buffer is null-terminated for sprintf safety
-
-    for (i = 0; i < 7; i++) {
-        if ((ptr - temp_buf + 6) < sizeof(temp_buf)) { // Check buffer bounds
-             ptr += sprintf(ptr, "0x%02x ", rx_buf[i]);
-        } else {
-            dev_warn(&adxl->spi->dev, "GET_DATA: temp_buf too small for full rx_buf print\n");
-            break;
-        }
-    }
-    //dev_info(&adxl->spi->dev, "get_data raw rx_buf: %s\n", temp_buf);
-
-    adxl->x = (s16)((rx_buf[2] << 8) | rx_buf[1]); // Use s16 for signed 16-bit
-    adxl->y = (s16)((rx_buf[4] << 8) | rx_buf[3]);
-    adxl->z = (s16)((rx_buf[6] << 8) | rx_buf[5]);
-
+    store_sample(adxl, raw);
     return 0;
 }
 static int adxl345_probe(struct spi_device *spi);
@@ -0,0 +1,50 @@
+#ifndef ADXL345_UAPI_H
+#define ADXL345_UAPI_H
+
+// Shared between the driver and userspace programs (see tests/)
+#include <linux/types.h>
+
+#define EVENT_DEVICE_NAME "adxl345_events"
+#define SAMPLE_DEVICE_NAME "adxl345_samples" // struct adxl345_sample, decimated
+#define RAW_DEVICE_NAME "adxl345_raw"         // struct adxl345_sample, full rate
+
+// Event types read from /dev/adxl345_events
+#define ADXL345_EV_SINGLE_TAP 1
+#define ADXL345_EV_DOUBLE_TAP 2
+#define ADXL345_EV_ACTIVITY   3
+#define ADXL345_EV_INACTIVITY 4
+#define ADXL345_EV_FREE_FALL  5
+#define ADXL345_EV_THRESHOLD  6 // Magnitude threshold crossed (capture trigger)
+#define ADXL345_EV_CAPTURE    7 // Capture snapshot frozen and ready to read
+
+// One record per read() slot, read() returns whole records only
+struct adxl345_event {
+    __u64 timestamp_ns; // CLOCK_MONOTONIC, taken when the interrupt fired
+    __u32 type;         // ADXL345_EV_*
+    __u32 int_source;   // Raw INT_SOURCE of the interrupt
+};
+
+// One acceleration sample in full resolution counts (3.9 mg/LSB)
+struct adxl345_sample {
+    __u64 timestamp_ns; // CLOCK_MONOTONIC
+    __s16 x;
+    __s16 y;
+    __s16 z;
+    __u16 reserved;
+};
+
+// Capture blob read from the "capture_data" sysfs binary attribute:
+// struct adxl345_capture_header followed by nr_samples struct adxl345_sample, oldest first
+#define ADXL345_CAPTURE_MAGIC 0x41584c43 // "CLXA"
+
+struct adxl345_capture_header {
+    __u32 magic;
+    __u32 trigger;      // ADXL345_EV_* that froze the window
+    __u64 trigger_ns;   // Timestamp of the trigger
+    __u32 nr_samples;
+    __u32 pre_samples;  // Samples before the trigger
+    __u32 odr_mhz;      // Output data rate during the capture
+    __u32 reserved;
+};
+
+#endif
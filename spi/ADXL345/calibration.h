@@ -0,0 +1,102 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+#include "ADXL345_spi.h"
+
+// Zero-g offset calibration through OFSX/OFSY/OFSZ. The chip adds the offsets to every
+// output sample, so consumers get corrected data with no per-sample work.
+
+// Program all three offset registers and cache them. Caller holds adxl->lock.
+static int offsets_write(struct my_ADXL345 *adxl, const s8 *ofs) {
+    int ret, i;
+
+    for (i = 0; i < 3; i++) {
+        ret = write_reg(adxl, REG_OFSX + i, (u8)ofs[i]);
+        if (ret)
+            return ret;
+        adxl->offset[i] = ofs[i];
+    }
+    return 0;
+}
+
+// Restore offsets saved in the device tree: offsets = <x y z> (15.6 mg/LSB, signed)
+static int offsets_init(struct my_ADXL345 *adxl, struct spi_device *spi) {
+    u32 vals[3];
+    s8 ofs[3];
+    int i;
+
+    if (of_property_read_u32_array(spi->dev.of_node, "offsets", vals, 3))
+        return 0; // No saved calibration, registers stay at 0
+
+    for (i = 0; i < 3; i++) {
+        if ((s32)vals[i] < S8_MIN || (s32)vals[i] > S8_MAX) {
+            dev_err(adxl->dev, "DT offset %d out of range\n", (s32)vals[i]);
+            return -EINVAL;
+        }
+        ofs[i] = (s32)vals[i];
+    }
+    dev_info(adxl->dev, "Offsets from DT: %d %d %d\n", ofs[0], ofs[1], ofs[2]);
+    return offsets_write(adxl, ofs);
+}
+
+// Average n samples at rest and compute offsets that null X/Y/Z, leaving +/-1g on the
+// axis gravity acts on (the one with the largest reading). Caller holds adxl->lock, so the
+// run is limited to CAL_TIME_MAX_MS; on failure the previous offsets are restored.
+static int calibrate(struct my_ADXL345 *adxl, unsigned int n) {
+    u32 odr_mhz = adxl345_odr_mhz[adxl->bw_rate & BW_RATE_RATE_MASK];
+    unsigned long period_us = max_t(unsigned long, div_u64(1000000000ULL, odr_mhz), 1000);
+    static const s8 zero[3] = { 0, 0, 0 };
+    s32 sum[3] = { 0, 0, 0 }, err;
+    unsigned long flags;
+    s8 ofs[3], old[3];
+    int ret, i, g_axis = 0;
+
+    if (adxl->fifo_watermark) // Polling DATAX0 would pop the IIO buffer's FIFO entries
+        return -EBUSY;
+    if ((u64)n * period_us > CAL_TIME_MAX_MS * 1000ULL) {
+        dev_err(adxl->dev, "%u samples take %llu ms at this rate, limit is %u ms. Raise the rate or use fewer.\n",
+                n, div_u64((u64)n * period_us, 1000), CAL_TIME_MAX_MS);
+        return -EINVAL;
+    }
+    memcpy(old, adxl->offset, sizeof(old));
+
+    // Measure without the old correction
+    ret = offsets_write(adxl, zero);
+    if (ret)
+        goto restore;
+
+    for (i = 0; i < n; i++) {
+        usleep_range(period_us, period_us + period_us / 4); // New sample every ODR period
+        ret = get_data(adxl);
+        if (ret)
+            goto restore;
+        spin_lock_irqsave(&adxl->data_lock, flags);
+        sum[0] += adxl->x;
+        sum[1] += adxl->y;
+        sum[2] += adxl->z;
+        spin_unlock_irqrestore(&adxl->data_lock, flags);
+    }
+
+    for (i = 1; i < 3; i++)
+        if (abs(sum[i]) > abs(sum[g_axis]))
+            g_axis = i;
+
+    for (i = 0; i < 3; i++) {
+        err = DIV_ROUND_CLOSEST(sum[i], (s32)n); // Average, 3.9 mg/LSB
+        if (i == g_axis)
+            err -= err < 0 ? -CAL_ONE_G_LSB : CAL_ONE_G_LSB;
+        // Offset registers are 15.6 mg/LSB, 4 output LSBs each
+        ofs[i] = clamp_t(s32, -DIV_ROUND_CLOSEST(err, 4), S8_MIN, S8_MAX);
+    }
+
+    dev_info(adxl->dev, "Calibrated over %u samples (gravity on %c): offsets %d %d %d\n",
+             n, 'X' + g_axis, ofs[0], ofs[1], ofs[2]);
+    ret = offsets_write(adxl, ofs);
+    if (!ret)
+        return 0;
+
+restore:
+    offsets_write(adxl, old); // Best effort, the bus already failed once
+    return ret;
+}
+
+#endif
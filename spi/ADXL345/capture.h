@@ -0,0 +1,184 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include "ADXL345_spi.h"
+
+// Pre-trigger capture: samples go into a ring sized pre + post while armed. A trigger
+// records post more samples and then freezes the ring until userspace re-arms it.
+
+// Magnitude threshold in squared full resolution counts (3.9 mg/LSB)
+static u64 capture_threshold_sq(u32 threshold_mg) {
+    u64 lsb = DIV_ROUND_CLOSEST((u64)threshold_mg * 10, 39);
+    return lsb * lsb;
+}
+
+// Freeze the window: caller holds capture_lock
+static void capture_freeze(struct my_ADXL345 *adxl) {
+    adxl->capture_state = CAPTURE_READY;
+    adxl->capture_hdr.nr_samples = adxl->capture_fill;
+    adxl->capture_hdr.pre_samples = adxl->capture_fill - adxl->capture_post_done;
+}
+
+// Trigger from an event or the threshold check (completion context)
+static void capture_event(struct my_ADXL345 *adxl, u32 type, u64 ts) {
+    unsigned long flags;
+    bool ready = false;
+
+    if (READ_ONCE(adxl->capture_state) != CAPTURE_ARMED ||
+        !(READ_ONCE(adxl->capture_triggers) & BIT(type)))
+        return;
+
+    spin_lock_irqsave(&adxl->capture_lock, flags);
+    if (adxl->capture_state == CAPTURE_ARMED) {
+        adxl->capture_hdr.trigger = type;
+        adxl->capture_hdr.trigger_ns = ts;
+        adxl->capture_post_done = 0;
+        if (adxl->capture_post) {
+            adxl->capture_state = CAPTURE_TRIGGERED;
+        } else {
+            capture_freeze(adxl);
+            ready = true;
+        }
+    }
+    spin_unlock_irqrestore(&adxl->capture_lock, flags);
+
+    if (ready)
+        push_event(adxl, ADXL345_EV_CAPTURE, 0, ts);
+}
+
+// Record one DATAX0..DATAZ1 sample (completion context)
+static void capture_sample(struct my_ADXL345 *adxl, const u8 *raw, u64 ts) {
+    struct adxl345_sample *s;
+    unsigned long flags;
+    bool ready = false;
+    s64 x, y, z;
+    u64 thr_sq;
+    int state = READ_ONCE(adxl->capture_state);
+
+    if (state != CAPTURE_ARMED && state != CAPTURE_TRIGGERED)
+        return;
+
+    x = (s16)((raw[1] << 8) | raw[0]);
+    y = (s16)((raw[3] << 8) | raw[2]);
+    z = (s16)((raw[5] << 8) | raw[4]);
+
+    spin_lock_irqsave(&adxl->capture_lock, flags);
+    s = &adxl->capture_buf[adxl->capture_head];
+    s->timestamp_ns = ts;
+    s->x = x;
+    s->y = y;
+    s->z = z;
+    s->reserved = 0;
+    adxl->capture_head = (adxl->capture_head + 1) % adxl->capture_len;
+    if (adxl->capture_fill < adxl->capture_len)
+        adxl->capture_fill++;
+
+    if (adxl->capture_state == CAPTURE_TRIGGERED) {
+        adxl->capture_post_done++;
+        if (adxl->capture_post_done >= adxl->capture_post) {
+            capture_freeze(adxl);
+            ready = true;
+        }
+    }
+    spin_unlock_irqrestore(&adxl->capture_lock, flags);
+
+    if (ready) {
+        push_event(adxl, ADXL345_EV_CAPTURE, 0, ts);
+        return;
+    }
+
+    thr_sq = capture_threshold_sq(READ_ONCE(adxl->capture_threshold_mg));
+    if (thr_sq && (u64)(x * x + y * y + z * z) >= thr_sq)
+        capture_event(adxl, ADXL345_EV_THRESHOLD, ts);
+}
+
+// Arm (or re-arm) with the current pre/post windows. Caller holds adxl->lock.
+static int capture_arm(struct my_ADXL345 *adxl) {
+    u32 odr_mhz = adxl345_odr_mhz[adxl->bw_rate & BW_RATE_RATE_MASK];
+    u32 pre, post;
+    unsigned long flags;
+
+    if (!adxl->capture_buf) {
+        adxl->capture_buf = kvcalloc(CAPTURE_MAX_SAMPLES, sizeof(*adxl->capture_buf), GFP_KERNEL);
+        if (!adxl->capture_buf)
+            return -ENOMEM;
+    }
+
+    pre = DIV_ROUND_UP_ULL((u64)adxl->capture_pre_ms * odr_mhz, 1000000);
+    post = DIV_ROUND_UP_ULL((u64)adxl->capture_post_ms * odr_mhz, 1000000);
+    if (pre + post > CAPTURE_MAX_SAMPLES) { // Keep the post window, trim the pre window
+        post = min_t(u32, post, CAPTURE_MAX_SAMPLES);
+        pre = CAPTURE_MAX_SAMPLES - post;
+        dev_info(adxl->dev, "Capture window clamped to %u + %u samples\n", pre, post);
+    }
+
+    spin_lock_irqsave(&adxl->capture_lock, flags);
+    adxl->capture_len = max_t(u32, pre + post, 1);
+    adxl->capture_post = post;
+    adxl->capture_post_done = 0;
+    adxl->capture_head = 0;
+    adxl->capture_fill = 0;
+    memset(&adxl->capture_hdr, 0, sizeof(adxl->capture_hdr));
+    adxl->capture_hdr.magic = ADXL345_CAPTURE_MAGIC;
+    adxl->capture_hdr.odr_mhz = odr_mhz;
+    adxl->capture_state = CAPTURE_ARMED;
+    spin_unlock_irqrestore(&adxl->capture_lock, flags);
+    return 0;
+}
+
+static void capture_disarm(struct my_ADXL345 *adxl) {
+    unsigned long flags;
+
+    spin_lock_irqsave(&adxl->capture_lock, flags);
+    adxl->capture_state = CAPTURE_OFF;
+    spin_unlock_irqrestore(&adxl->capture_lock, flags);
+}
+
+// Copy the frozen window (header + samples, oldest first) at byte offset off
+static ssize_t capture_copy(struct my_ADXL345 *adxl, char *buf, loff_t off, size_t count) {
+    const size_t hdr_len = sizeof(struct adxl345_capture_header);
+    const size_t smp_len = sizeof(struct adxl345_sample);
+    unsigned long flags;
+    size_t total, done = 0;
+    u32 start;
+
+    spin_lock_irqsave(&adxl->capture_lock, flags);
+    if (adxl->capture_state != CAPTURE_READY)
+        goto out;
+
+    total = hdr_len + adxl->capture_hdr.nr_samples * smp_len;
+    if (off >= total)
+        goto out;
+    count = min_t(size_t, count, total - off);
+    start = (adxl->capture_head + adxl->capture_len - adxl->capture_hdr.nr_samples) % adxl->capture_len;
+
+    while (done < count) {
+        size_t pos = off + done;
+        const u8 *src;
+        size_t avail;
+
+        if (pos < hdr_len) {
+            src = (const u8 *)&adxl->capture_hdr + pos;
+            avail = hdr_len - pos;
+        } else {
+            size_t idx = (pos - hdr_len) / smp_len;
+            size_t in = (pos - hdr_len) % smp_len;
+
+            src = (const u8 *)&adxl->capture_buf[(start + idx) % adxl->capture_len] + in;
+            avail = smp_len - in;
+        }
+        avail = min(avail, count - done);
+        memcpy(buf + done, src, avail);
+        done += avail;
+    }
+out:
+    spin_unlock_irqrestore(&adxl->capture_lock, flags);
+    return done;
+}
+
+static void capture_cleanup(struct my_ADXL345 *adxl) {
+    capture_disarm(adxl);
+    kvfree(adxl->capture_buf);
+    adxl->capture_buf = NULL;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef DECIMATE_H
+#define DECIMATE_H
+#include "ADXL345_spi.h"
+
+// Averaging decimator: "decimation" consecutive samples are summed and one mean sample
+// goes to /dev/adxl345_samples. The boxcar average is the FIR (first order CIC) anti-alias
+// filter for the lower output rate; the full rate stream stays on /dev/adxl345_raw.
+
+// Feed one DATAX0..DATAZ1 sample (completion context)
+static void decimate_sample(struct my_ADXL345 *adxl, const u8 *raw, u64 ts) {
+    struct adxl345_sample s = { .timestamp_ns = ts };
+    u32 factor = READ_ONCE(adxl->decimation);
+
+    s.x = (s16)((raw[1] << 8) | raw[0]);
+    s.y = (s16)((raw[3] << 8) | raw[2]);
+    s.z = (s16)((raw[5] << 8) | raw[4]);
+
+    if (atomic_read(&adxl->raw.users))
+        stream_push(&adxl->raw, &s);
+
+    if (!atomic_read(&adxl->samples.users)) {
+        adxl->dec_count = 0; // Nobody listening, restart the block on open
+        return;
+    }
+
+    if (factor <= 1) {
+        stream_push(&adxl->samples, &s);
+        return;
+    }
+
+    if (adxl->dec_count == 0) {
+        adxl->dec_first_ns = ts;
+        adxl->dec_sum[0] = adxl->dec_sum[1] = adxl->dec_sum[2] = 0;
+    }
+    adxl->dec_sum[0] += s.x;
+    adxl->dec_sum[1] += s.y;
+    adxl->dec_sum[2] += s.z;
+    adxl->dec_count++;
+
+    // Also flushes a partial block when decimation was lowered mid block
+    if (adxl->dec_count >= factor) {
+        s.x = DIV_ROUND_CLOSEST(adxl->dec_sum[0], (s32)adxl->dec_count);
+        s.y = DIV_ROUND_CLOSEST(adxl->dec_sum[1], (s32)adxl->dec_count);
+        s.z = DIV_ROUND_CLOSEST(adxl->dec_sum[2], (s32)adxl->dec_count);
+        // Boxcar group delay: stamp the record at the middle of the block
+        s.timestamp_ns = adxl->dec_first_ns + (ts - adxl->dec_first_ns) / 2;
+        stream_push(&adxl->samples, &s);
+        adxl->dec_count = 0;
+    }
+}
+
+#endif
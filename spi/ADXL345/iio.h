@@ -0,0 +1,295 @@
+#ifndef IIO_H
+#define IIO_H
+#include "ADXL345_spi.h"
+
+// IIO device: in_accel_{x,y,z}_raw with a shared scale and sampling_frequency, and a
+// triggered buffer (kfifo) fed by the interrupt path. The completion stages every sample
+// with its timestamp in iio_fifo and fires the data-ready trigger; the pollfunc pushes the
+// staged samples. With a buffer watermark > 1 the hardware FIFO runs in stream mode and
+// interrupts once per watermark samples instead of once per sample.
+
+#define ADXL345_SCALE_UM_S2 38246 // Full resolution 3.9 mg/LSB in um/s^2
+
+#define ADXL345_ACCEL_CHANNEL(_idx, _axis) {                        \
+    .type = IIO_ACCEL,                                              \
+    .modified = 1,                                                  \
+    .channel2 = IIO_MOD_##_axis,                                    \
+    .info_mask_separate = BIT(IIO_CHAN_INFO_RAW),                   \
+    .info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),           \
+    .info_mask_shared_by_all = BIT(IIO_CHAN_INFO_SAMP_FREQ),        \
+    .info_mask_shared_by_all_available = BIT(IIO_CHAN_INFO_SAMP_FREQ), \
+    .scan_index = _idx,                                             \
+    .scan_type = {                                                  \
+        .sign = 's',                                                \
+        .realbits = 16,                                             \
+        .storagebits = 16,                                          \
+        .endianness = IIO_CPU,                                      \
+    },                                                              \
+}
+
+static const struct iio_chan_spec adxl345_iio_channels[] = {
+    ADXL345_ACCEL_CHANNEL(0, X),
+    ADXL345_ACCEL_CHANNEL(1, Y),
+    ADXL345_ACCEL_CHANNEL(2, Z),
+    IIO_CHAN_SOFT_TIMESTAMP(3),
+};
+
+// X, Y and Z come from one read, the core demuxes subsets
+static const unsigned long adxl345_scan_masks[] = { 0x7, 0 };
+
+// ODR table as IIO_VAL_INT_PLUS_MICRO pairs, filled in iio_init()
+static int adxl345_freq_avail[ARRAY_SIZE(adxl345_odr_mhz) * 2];
+
+static struct my_ADXL345 *iio_to_adxl(struct iio_dev *indio_dev) {
+    return *(struct my_ADXL345 **)iio_priv(indio_dev);
+}
+
+static int adxl345_read_raw(struct iio_dev *indio_dev, struct iio_chan_spec const *chan,
+                            int *val, int *val2, long mask) {
+    struct my_ADXL345 *adxl = iio_to_adxl(indio_dev);
+    unsigned long flags;
+    u32 mhz;
+    int ret;
+
+    switch (mask) {
+    case IIO_CHAN_INFO_RAW:
+        ret = iio_device_claim_direct_mode(indio_dev); // The buffer owns the data path
+        if (ret)
+            return ret;
+        ret = adxl_pm_get(adxl);
+        if (ret) {
+            iio_device_release_direct_mode(indio_dev);
+            return ret;
+        }
+        mutex_lock(&adxl->lock);
+        ret = get_data(adxl);
+        mutex_unlock(&adxl->lock);
+        adxl_pm_put(adxl);
+        iio_device_release_direct_mode(indio_dev);
+        if (ret)
+            return ret;
+
+        spin_lock_irqsave(&adxl->data_lock, flags);
+        *val = chan->channel2 == IIO_MOD_X ? adxl->x :
+               chan->channel2 == IIO_MOD_Y ? adxl->y : adxl->z;
+        spin_unlock_irqrestore(&adxl->data_lock, flags);
+        return IIO_VAL_INT;
+    case IIO_CHAN_INFO_SCALE:
+        *val = 0;
+        *val2 = ADXL345_SCALE_UM_S2;
+        return IIO_VAL_INT_PLUS_MICRO;
+    case IIO_CHAN_INFO_SAMP_FREQ:
+        mhz = adxl345_odr_mhz[READ_ONCE(adxl->bw_rate) & BW_RATE_RATE_MASK];
+        *val = mhz / 1000;
+        *val2 = (mhz % 1000) * 1000;
+        return IIO_VAL_INT_PLUS_MICRO;
+    default:
+        return -EINVAL;
+    }
+}
+
+static int adxl345_write_raw(struct iio_dev *indio_dev, struct iio_chan_spec const *chan,
+                             int val, int val2, long mask) {
+    struct my_ADXL345 *adxl = iio_to_adxl(indio_dev);
+    int ret;
+
+    switch (mask) {
+    case IIO_CHAN_INFO_SAMP_FREQ:
+        if (val < 0 || val2 < 0 || (val == 0 && val2 == 0))
+            return -EINVAL;
+        mutex_lock(&adxl->lock);
+        ret = set_bw_rate(adxl, odr_to_code(val * 1000 + val2 / 1000));
+        mutex_unlock(&adxl->lock);
+        return ret;
+    default:
+        return -EINVAL;
+    }
+}
+
+static int adxl345_read_avail(struct iio_dev *indio_dev, struct iio_chan_spec const *chan,
+                              const int **vals, int *type, int *length, long mask) {
+    switch (mask) {
+    case IIO_CHAN_INFO_SAMP_FREQ:
+        *vals = adxl345_freq_avail;
+        *type = IIO_VAL_INT_PLUS_MICRO;
+        *length = ARRAY_SIZE(adxl345_freq_avail);
+        return IIO_AVAIL_LIST;
+    default:
+        return -EINVAL;
+    }
+}
+
+// Called by the IIO core with the buffer watermark before the buffer is enabled
+static int adxl345_hwfifo_set_watermark(struct iio_dev *indio_dev, unsigned int val) {
+    struct my_ADXL345 *adxl = iio_to_adxl(indio_dev);
+
+    mutex_lock(&adxl->lock);
+    adxl->hw_watermark = clamp_val(val, 1, FIFO_WATERMARK_MAX);
+    mutex_unlock(&adxl->lock);
+    return 0;
+}
+
+static const struct iio_info adxl345_iio_info = {
+    .read_raw = adxl345_read_raw,
+    .write_raw = adxl345_write_raw,
+    .read_avail = adxl345_read_avail,
+    .hwfifo_set_watermark = adxl345_hwfifo_set_watermark,
+};
+
+static int adxl345_buffer_preenable(struct iio_dev *indio_dev) {
+    return adxl_pm_get(iio_to_adxl(indio_dev));
+}
+
+static int adxl345_buffer_postenable(struct iio_dev *indio_dev) {
+    struct my_ADXL345 *adxl = iio_to_adxl(indio_dev);
+    int ret;
+
+    mutex_lock(&adxl->lock);
+    kfifo_reset(&adxl->iio_fifo); // Pollfunc is not running yet
+    WRITE_ONCE(adxl->iio_active, true);
+    ret = set_fifo_watermark(adxl, adxl->hw_watermark);
+    if (ret)
+        WRITE_ONCE(adxl->iio_active, false);
+    mutex_unlock(&adxl->lock);
+    return ret;
+}
+
+static int adxl345_buffer_predisable(struct iio_dev *indio_dev) {
+    struct my_ADXL345 *adxl = iio_to_adxl(indio_dev);
+    int ret;
+
+    mutex_lock(&adxl->lock);
+    WRITE_ONCE(adxl->iio_active, false);
+    ret = set_fifo_watermark(adxl, 0);
+    mutex_unlock(&adxl->lock);
+    irq_work_sync(&adxl->iio_work);
+    return ret;
+}
+
+static int adxl345_buffer_postdisable(struct iio_dev *indio_dev) {
+    adxl_pm_put(iio_to_adxl(indio_dev));
+    return 0;
+}
+
+static const struct iio_buffer_setup_ops adxl345_buffer_ops = {
+    .preenable = adxl345_buffer_preenable,
+    .postenable = adxl345_buffer_postenable,
+    .predisable = adxl345_buffer_predisable,
+    .postdisable = adxl345_buffer_postdisable,
+};
+
+static ssize_t hwfifo_enabled_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = iio_to_adxl(dev_to_iio_dev(dev));
+
+    return sysfs_emit(buf, "%d\n", READ_ONCE(adxl->fifo_watermark) ? 1 : 0);
+}
+
+static ssize_t hwfifo_watermark_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = iio_to_adxl(dev_to_iio_dev(dev));
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(adxl->fifo_watermark));
+}
+
+static IIO_STATIC_CONST_DEVICE_ATTR(hwfifo_watermark_min, "1");
+static IIO_STATIC_CONST_DEVICE_ATTR(hwfifo_watermark_max, __stringify(FIFO_WATERMARK_MAX));
+static IIO_DEVICE_ATTR_RO(hwfifo_enabled, 0);
+static IIO_DEVICE_ATTR_RO(hwfifo_watermark, 0);
+
+static const struct iio_dev_attr *adxl345_fifo_attributes[] = {
+    &iio_dev_attr_hwfifo_watermark_min,
+    &iio_dev_attr_hwfifo_watermark_max,
+    &iio_dev_attr_hwfifo_enabled,
+    &iio_dev_attr_hwfifo_watermark,
+    NULL
+};
+
+// Pollfunc thread: push everything the completion staged since the last trigger
+static irqreturn_t adxl345_trigger_handler(int irq, void *p) {
+    struct iio_poll_func *pf = p;
+    struct iio_dev *indio_dev = pf->indio_dev;
+    struct my_ADXL345 *adxl = iio_to_adxl(indio_dev);
+    struct adxl345_sample s;
+    s64 clock_offset;
+
+    // Sample stamps are CLOCK_MONOTONIC, report them in the device's timestamp clock
+    clock_offset = iio_get_time_ns(indio_dev) - ktime_get_ns();
+    while (kfifo_get(&adxl->iio_fifo, &s)) {
+        adxl->iio_scan.chan[0] = s.x;
+        adxl->iio_scan.chan[1] = s.y;
+        adxl->iio_scan.chan[2] = s.z;
+        iio_push_to_buffers_with_timestamp(indio_dev, &adxl->iio_scan,
+                                           (s64)s.timestamp_ns + clock_offset);
+    }
+
+    iio_trigger_notify_done(indio_dev->trig);
+    return IRQ_HANDLED;
+}
+
+// iio_trigger_poll() wants hard IRQ context, SPI completions don't guarantee it
+static void adxl345_iio_work(struct irq_work *work) {
+    struct my_ADXL345 *adxl = container_of(work, struct my_ADXL345, iio_work);
+
+    iio_trigger_poll(adxl->iio_trig);
+}
+
+static int iio_init(struct my_ADXL345 *adxl, struct spi_device *spi) {
+    struct iio_dev *indio_dev;
+    int ret, i;
+
+    for (i = 0; i < ARRAY_SIZE(adxl345_odr_mhz); i++) {
+        adxl345_freq_avail[2 * i] = adxl345_odr_mhz[i] / 1000;
+        adxl345_freq_avail[2 * i + 1] = (adxl345_odr_mhz[i] % 1000) * 1000;
+    }
+    INIT_KFIFO(adxl->iio_fifo);
+    init_irq_work(&adxl->iio_work, adxl345_iio_work);
+    adxl->hw_watermark = 1;
+
+    indio_dev = devm_iio_device_alloc(&spi->dev, sizeof(adxl));
+    if (!indio_dev)
+        return -ENOMEM;
+    *(struct my_ADXL345 **)iio_priv(indio_dev) = adxl;
+    indio_dev->name = DEVICE_NAME;
+    indio_dev->info = &adxl345_iio_info;
+    indio_dev->modes = INDIO_DIRECT_MODE;
+    indio_dev->channels = adxl345_iio_channels;
+    indio_dev->num_channels = ARRAY_SIZE(adxl345_iio_channels);
+    indio_dev->available_scan_masks = adxl345_scan_masks;
+
+    adxl->iio_trig = devm_iio_trigger_alloc(&spi->dev, "%s-dev%d", indio_dev->name,
+                                            iio_device_id(indio_dev));
+    if (!adxl->iio_trig)
+        return -ENOMEM;
+    ret = devm_iio_trigger_register(&spi->dev, adxl->iio_trig);
+    if (ret) {
+        dev_err(adxl->dev, "IIO trigger register failed: %d\n", ret);
+        return ret;
+    }
+    indio_dev->trig = iio_trigger_get(adxl->iio_trig); // Data-ready is the default trigger
+
+    ret = devm_iio_triggered_buffer_setup_ext(&spi->dev, indio_dev, iio_pollfunc_store_time,
+                                              adxl345_trigger_handler, IIO_BUFFER_DIRECTION_IN,
+                                              &adxl345_buffer_ops, adxl345_fifo_attributes);
+    if (ret) {
+        dev_err(adxl->dev, "IIO buffer setup failed: %d\n", ret);
+        return ret;
+    }
+
+    // Registered by hand: it must go away in remove() before the interrupt path does
+    ret = iio_device_register(indio_dev);
+    if (ret) {
+        dev_err(adxl->dev, "IIO device register failed: %d\n", ret);
+        return ret;
+    }
+    adxl->indio_dev = indio_dev;
+    return 0;
+}
+
+static void iio_cleanup(struct my_ADXL345 *adxl) {
+    if (!adxl->indio_dev)
+        return;
+    iio_device_unregister(adxl->indio_dev); // Disables a running buffer
+    irq_work_sync(&adxl->iio_work);
+    adxl->indio_dev = NULL;
+}
+
+#endif
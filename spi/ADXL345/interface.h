@@ -13,7 +13,7 @@ static ssize_t range_store(struct device *dev, struct device_attribute *attr, co
     struct my_ADXL345 *adxl = dev_get_drvdata(dev); // dev is &spi->dev here
     int new_range;
     int ret;
-    uint8_t data_format_val; 
+    u8 range_bits;
 
     if (!adxl) return -ENODEV;
 
@@ -26,36 +26,16 @@ static ssize_t range_store(struct device *dev, struct device_attribute *attr, co
         return -EINVAL;
     }
 
-    // Protect access to adxl->range and SPI write
+    // Read-modify-write from the register cache: only FULL_RES and the range bits change,
+    // the rest of DATA_FORMAT (INT_INVERT, JUSTIFY, ...) is kept
+    range_bits = ilog2(new_range) - 1; // 2g=0, 4g=1, 8g=2, 16g=3
     mutex_lock(&adxl->lock);
-    adxl->range = new_range;
-
-    // Preserve other bits in DATA_FORMAT (like INT_INVERT if you ever set it)
-    // For now, assuming FULL_RES (D3) is always desired if range is set.
-    // And range bits are D0, D1. INT_INVERT is D5.
-    // Let's assume INT_INVERT is always 0 (active high interrupts) for now.
-    // 0x08 = FULL_RES, +/-2g
-    switch (new_range) {
-        case 2:  
-            data_format_val = 0x08; 
-            break; // +/- 2g, FULL_RES
-        case 4:  
-            data_format_val = 0x09; 
-            break; // +/- 4g, FULL_RES
-        case 8:  
-            data_format_val = 0x0A; 
-            break; // +/- 8g, FULL_RES
-        case 16: 
-            data_format_val = 0x0B; 
-            break; // +/- 16g, FULL_RES
-        default: 
-            mutex_unlock(&adxl->lock);
-            return -EINVAL;
-    }
-
-    dev_info(dev, "Storing new range %dG, writing 0x%02x to DATA_FORMAT\n", new_range, data_format_val);
-    ret = write_reg(adxl->spi, REG_DATA_FORMAT, data_format_val);
+    ret = update_reg(adxl, REG_DATA_FORMAT, DATA_FORMAT_FULL_RES | DATA_FORMAT_RANGE_MASK,
+                     DATA_FORMAT_FULL_RES | range_bits);
+    if (!ret)
+        adxl->range = new_range;
     mutex_unlock(&adxl->lock);
+    dev_info(dev, "Storing new range %dG\n", new_range);
 
     if (ret) {
         dev_err(dev, "Failed to write DATA_FORMAT for new range: %d\n", ret);
@@ -64,70 +44,652 @@ static ssize_t range_store(struct device *dev, struct device_attribute *attr, co
     return count;
 }
 
-// sysfs - Sampling rate
+// Rates are handled in mHz so fractional ODRs (12.5Hz, 6.25Hz, ...) are exact
+static int format_mhz(char *buf, size_t size, unsigned int mhz) {
+    unsigned int frac = mhz % 1000;
+    int digits = 3;
+
+    if (!frac)
+        return scnprintf(buf, size, "%u", mhz / 1000);
+    while (frac % 10 == 0) { // Trim trailing zeros: 12.500 -> 12.5
+        frac /= 10;
+        digits--;
+    }
+    return scnprintf(buf, size, "%u.%0*u", mhz / 1000, digits, frac);
+}
+
+// Parse "100", "12.5" or "0.78" into mHz
+static int parse_mhz(const char *buf, unsigned int *mhz) {
+    unsigned int hz = 0, frac = 0, scale = 100;
+
+    if (!isdigit(*buf))
+        return -EINVAL;
+    while (isdigit(*buf)) {
+        hz = hz * 10 + (*buf++ - '0');
+        if (hz > 100000)
+            return -ERANGE;
+    }
+    if (*buf == '.') {
+        buf++;
+        while (isdigit(*buf)) {
+            frac += (*buf++ - '0') * scale; // Digits past mHz resolution are dropped
+            scale /= 10;
+        }
+    }
+    if (*buf == '\n')
+        buf++;
+    if (*buf)
+        return -EINVAL;
+
+    *mhz = hz * 1000 + frac;
+    return 0;
+}
+
+// Rate code whose ODR is closest to the requested rate
+static u8 odr_to_code(unsigned int mhz) {
+    u8 code, best = 0;
+
+    for (code = 1; code < ARRAY_SIZE(adxl345_odr_mhz); code++) {
+        if (abs((int)adxl345_odr_mhz[code] - (int)mhz) <
+            abs((int)adxl345_odr_mhz[best] - (int)mhz))
+            best = code;
+    }
+    return best;
+}
+
+// Program BW_RATE from a rate code and the low power request. Caller holds adxl->lock.
+static int set_bw_rate(struct my_ADXL345 *adxl, u8 code) {
+    u8 bw_rate_val = code & BW_RATE_RATE_MASK;
+    int ret;
+
+    // LOW_POWER is only specified for 12.5Hz - 400Hz, run other rates in normal mode
+    if (adxl->low_power && code >= ODR_LOW_POWER_MIN && code <= ODR_LOW_POWER_MAX)
+        bw_rate_val |= BW_RATE_LOW_POWER;
+
+    ret = update_reg(adxl, REG_BW_RATE, BW_RATE_LOW_POWER | BW_RATE_RATE_MASK, bw_rate_val);
+    if (ret)
+        return ret;
+
+    adxl->bw_rate = bw_rate_val;
+    ts_reset(adxl);
+    WRITE_ONCE(adxl->measured_mhz, 0); // Restart the rate measurement
+    WRITE_ONCE(adxl->meas_start_ns, 0);
+    return 0;
+}
+
+// sysfs - Sampling rate (also exposed as sampling_frequency)
 static ssize_t rate_show(struct device *dev, struct device_attribute *attr, char *buf) {
     struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    int len;
+
     if (!adxl) 
         return -ENODEV;
-    return sprintf(buf, "%d\n", adxl->rate);
+    // Report the ODR the chip is actually running at, not the value written
+    len = format_mhz(buf, PAGE_SIZE, adxl345_odr_mhz[adxl->bw_rate & BW_RATE_RATE_MASK]);
+    return len + scnprintf(buf + len, PAGE_SIZE - len, "\n");
 }
 
 static ssize_t rate_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
     struct my_ADXL345 *adxl = dev_get_drvdata(dev);
-    int new_rate;
+    unsigned int new_mhz;
     int ret;
-    uint8_t bw_rate_val;
+    u8 code;
 
     if (!adxl) return -ENODEV;
 
-    ret = kstrtoint(buf, 0, &new_rate);
+    ret = parse_mhz(buf, &new_mhz);
     if (ret)
         return ret;
 
-    if (new_rate <= 0) { // Basic check
-        dev_err(dev, "Invalid rate value: %d. Must be > 0.\n", new_rate);
+    if (new_mhz == 0) { // Basic check
+        dev_err(dev, "Invalid rate value: 0. Must be > 0.\n");
         return -EINVAL;
     }
 
+    code = odr_to_code(new_mhz);
+
     mutex_lock(&adxl->lock);
-    adxl->rate = new_rate; // Store user's desired rate, map to ADXL345 value
-
-    // Map user desired rate to ADXL345 BW_RATE register value
-    // These are Output Data Rates (ODR). Lower bits also control bandwidth.
-    // Example mapping (check datasheet for exact ODR vs register value)
-    if (new_rate <= 6)       bw_rate_val = 0x06; // 6.25Hz
-    else if (new_rate <= 12) bw_rate_val = 0x07; // 12.5Hz
-    else if (new_rate <= 25) bw_rate_val = 0x08; // 25Hz
-    else if (new_rate <= 50) bw_rate_val = 0x09; // 50Hz
-    else if (new_rate <= 100)bw_rate_val = 0x0A; // 100Hz
-    else if (new_rate <= 200)bw_rate_val = 0x0B; // 200Hz
-    else if (new_rate <= 400)bw_rate_val = 0x0C; // 400Hz
-    else if (new_rate <= 800)bw_rate_val = 0x0D; // 800Hz
-    else if (new_rate <= 1600)bw_rate_val = 0x0E; // 1600Hz
-    else                     bw_rate_val = 0x0F; // 3200Hz (max normal mode)
-
-    dev_info(dev, "Storing new rate %dHz, writing 0x%02x to BW_RATE\n", new_rate, bw_rate_val);
-    ret = write_reg(adxl->spi, REG_BW_RATE, bw_rate_val);
+    ret = set_bw_rate(adxl, code);
     mutex_unlock(&adxl->lock);
 
     if (ret) {
         dev_err(dev, "Failed to write BW_RATE for new rate: %d\n", ret);
         return ret;
     }
+    dev_info(dev, "Rate set to ODR code 0x%02x (%u mHz), BW_RATE 0x%02x\n",
+             code, adxl345_odr_mhz[code], adxl->bw_rate);
+    return count;
+}
+
+// sysfs - Supported ODRs in Hz
+static ssize_t sampling_frequency_available_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    int len = 0;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(adxl345_odr_mhz); i++) {
+        len += format_mhz(buf + len, PAGE_SIZE - len, adxl345_odr_mhz[i]);
+        len += scnprintf(buf + len, PAGE_SIZE - len,
+                         i == ARRAY_SIZE(adxl345_odr_mhz) - 1 ? "\n" : " ");
+    }
+    return len;
+}
+
+// sysfs - Low power mode (1 = requested, effective for 12.5Hz - 400Hz)
+static ssize_t low_power_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    if (!adxl) 
+        return -ENODEV;
+    return sprintf(buf, "%d\n", adxl->low_power);
+}
+
+static ssize_t low_power_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    bool enable;
+    int ret;
+
+    if (!adxl) return -ENODEV;
+
+    ret = kstrtobool(buf, &enable);
+    if (ret)
+        return ret;
+
+    mutex_lock(&adxl->lock);
+    adxl->low_power = enable;
+    ret = set_bw_rate(adxl, adxl->bw_rate & BW_RATE_RATE_MASK);
+    mutex_unlock(&adxl->lock);
+
+    if (ret) {
+        dev_err(dev, "Failed to write BW_RATE for low power: %d\n", ret);
+        return ret;
+    }
+    if (enable && !(adxl->bw_rate & BW_RATE_LOW_POWER))
+        dev_info(dev, "Low power not supported at current ODR, applied once rate is 12.5Hz - 400Hz\n");
+    return count;
+}
+
+// sysfs - Rate measured from DATA_READY timestamps, 0 until a window completes
+static ssize_t measured_rate_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    unsigned int mhz;
+
+    if (!adxl) 
+        return -ENODEV;
+    mhz = READ_ONCE(adxl->measured_mhz);
+    return sprintf(buf, "%u.%03u\n", mhz / 1000, mhz % 1000);
+}
+
+// sysfs - Register backed settings, value = raw * scale / 1000 in the attribute's unit
+struct adxl345_reg_attr {
+    struct device_attribute attr;
+    u8 reg;
+    unsigned int scale; // Unit per LSB, times 1000
+};
+
+#define ADXL_REG_ATTR(_name, _reg, _scale) \
+    struct adxl345_reg_attr dev_attr_##_name = { \
+        .attr = __ATTR(_name, 0644, reg_attr_show, reg_attr_store), \
+        .reg = _reg, \
+        .scale = _scale, \
+    }
+
+static ssize_t reg_attr_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    struct adxl345_reg_attr *ra = container_of(attr, struct adxl345_reg_attr, attr);
+    u8 val;
+    int ret;
+
+    if (!adxl) 
+        return -ENODEV;
+
+    mutex_lock(&adxl->lock);
+    ret = read_reg(adxl, ra->reg, &val);
+    mutex_unlock(&adxl->lock);
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "%u\n", val * ra->scale / 1000);
+}
+
+static ssize_t reg_attr_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    struct adxl345_reg_attr *ra = container_of(attr, struct adxl345_reg_attr, attr);
+    unsigned int val, raw;
+    int ret;
+
+    if (!adxl) return -ENODEV;
+
+    ret = kstrtouint(buf, 0, &val);
+    if (ret)
+        return ret;
+
+    raw = DIV_ROUND_CLOSEST((u64)val * 1000, ra->scale);
+    if (raw > 0xFF) {
+        dev_err(dev, "Value %u out of range, max %u\n", val, 0xFF * ra->scale / 1000);
+        return -EINVAL;
+    }
+
+    mutex_lock(&adxl->lock);
+    ret = write_reg(adxl, ra->reg, raw);
+    mutex_unlock(&adxl->lock);
+
+    return ret ? ret : count;
+}
+
+static ADXL_REG_ATTR(tap_threshold_mg, REG_THRESH_TAP, 62500); // 62.5 mg/LSB
+static ADXL_REG_ATTR(tap_duration_us, REG_DUR, 625000);        // 625 us/LSB
+static ADXL_REG_ATTR(tap_latency_us, REG_LATENT, 1250000);     // 1.25 ms/LSB
+static ADXL_REG_ATTR(tap_window_us, REG_WINDOW, 1250000);      // 1.25 ms/LSB
+static ADXL_REG_ATTR(activity_threshold_mg, REG_THRESH_ACT, 62500);     // 62.5 mg/LSB
+static ADXL_REG_ATTR(inactivity_threshold_mg, REG_THRESH_INACT, 62500); // 62.5 mg/LSB
+static ADXL_REG_ATTR(inactivity_time_s, REG_TIME_INACT, 1000);          // 1 s/LSB
+static ADXL_REG_ATTR(act_inact_ctl, REG_ACT_INACT_CTL, 1000);           // Raw register
+
+// sysfs - Auto sleep: stop data interrupts while still, wake on activity
+static ssize_t auto_sleep_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    if (!adxl) 
+        return -ENODEV;
+    return sprintf(buf, "%d\n", READ_ONCE(adxl->auto_sleep));
+}
+
+static ssize_t auto_sleep_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    bool enable;
+    int ret;
+
+    if (!adxl) return -ENODEV;
+
+    ret = kstrtobool(buf, &enable);
+    if (ret)
+        return ret;
+
+    mutex_lock(&adxl->lock);
+    ret = set_auto_sleep(adxl, enable);
+    mutex_unlock(&adxl->lock);
+
+    if (ret) {
+        dev_err(dev, "Failed to configure auto sleep: %d\n", ret);
+        return ret;
+    }
+    return count;
+}
+
+// Idle statistics including an idle period still in progress
+static void idle_stats(struct my_ADXL345 *adxl, u64 *idle_ns, u64 *avoided, u32 *sleeps) {
+    unsigned long flags;
+
+    spin_lock_irqsave(&adxl->data_lock, flags);
+    *idle_ns = adxl->idle_total_ns;
+    *avoided = adxl->avoided_irqs;
+    *sleeps = adxl->sleep_count;
+    if (adxl->idle) {
+        u64 cur = ktime_get_ns() - adxl->idle_since_ns;
+        *idle_ns += cur;
+        *avoided += idle_irqs(adxl, cur);
+    }
+    spin_unlock_irqrestore(&adxl->data_lock, flags);
+}
+
+static ssize_t idle_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    if (!adxl) 
+        return -ENODEV;
+    return sprintf(buf, "%d\n", READ_ONCE(adxl->idle));
+}
+
+static ssize_t sleep_count_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    u64 idle_ns, avoided;
+    u32 sleeps;
+
+    if (!adxl) 
+        return -ENODEV;
+    idle_stats(adxl, &idle_ns, &avoided, &sleeps);
+    return sprintf(buf, "%u\n", sleeps);
+}
+
+static ssize_t idle_time_ms_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    u64 idle_ns, avoided;
+    u32 sleeps;
+
+    if (!adxl) 
+        return -ENODEV;
+    idle_stats(adxl, &idle_ns, &avoided, &sleeps);
+    return sprintf(buf, "%llu\n", div_u64(idle_ns, NSEC_PER_MSEC));
+}
+
+// Interrupts and SPI burst bytes not spent while idle, estimated from the ODR
+static ssize_t avoided_irqs_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    u64 idle_ns, avoided;
+    u32 sleeps;
+
+    if (!adxl) 
+        return -ENODEV;
+    idle_stats(adxl, &idle_ns, &avoided, &sleeps);
+    return sprintf(buf, "%llu\n", avoided);
+}
+
+static ssize_t avoided_spi_bytes_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    u64 idle_ns, avoided;
+    u32 sleeps;
+
+    if (!adxl) 
+        return -ENODEV;
+    idle_stats(adxl, &idle_ns, &avoided, &sleeps);
+    return sprintf(buf, "%llu\n", avoided * IRQ_BURST_LEN);
+}
+
+// sysfs - Single taps within this many ms after a double tap are suppressed
+static ssize_t double_tap_cooldown_ms_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    if (!adxl) 
+        return -ENODEV;
+    return sprintf(buf, "%u\n", READ_ONCE(adxl->double_tap_cooldown_ms));
+}
+
+static ssize_t double_tap_cooldown_ms_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    unsigned int val;
+    int ret;
+
+    if (!adxl) return -ENODEV;
+
+    ret = kstrtouint(buf, 0, &val);
+    if (ret)
+        return ret;
+    WRITE_ONCE(adxl->double_tap_cooldown_ms, val);
+    return count;
+}
+
+// sysfs - Offset registers "x y z" (15.6 mg/LSB), write to restore a saved calibration
+static ssize_t offset_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    int len;
+
+    if (!adxl) 
+        return -ENODEV;
+    mutex_lock(&adxl->lock);
+    len = sprintf(buf, "%d %d %d\n", adxl->offset[0], adxl->offset[1], adxl->offset[2]);
+    mutex_unlock(&adxl->lock);
+    return len;
+}
+
+static ssize_t offset_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    int vals[3], i, ret;
+    s8 ofs[3];
+
+    if (!adxl) return -ENODEV;
+
+    if (sscanf(buf, "%d %d %d", &vals[0], &vals[1], &vals[2]) != 3)
+        return -EINVAL;
+    for (i = 0; i < 3; i++) {
+        if (vals[i] < S8_MIN || vals[i] > S8_MAX) {
+            dev_err(dev, "Invalid offset %d. Must be %d to %d.\n", vals[i], S8_MIN, S8_MAX);
+            return -EINVAL;
+        }
+        ofs[i] = vals[i];
+    }
+
+    mutex_lock(&adxl->lock);
+    ret = offsets_write(adxl, ofs);
+    mutex_unlock(&adxl->lock);
+
+    return ret ? ret : count;
+}
+
+// sysfs - Write N to calibrate over N samples with the device at rest
+static ssize_t calibrate_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    unsigned int n;
+    int ret;
+
+    if (!adxl) return -ENODEV;
+
+    ret = kstrtouint(buf, 0, &n);
+    if (ret)
+        return ret;
+    if (n < 1 || n > CAL_SAMPLES_MAX) {
+        dev_err(dev, "Invalid sample count %u. Must be 1 - %u.\n", n, CAL_SAMPLES_MAX);
+        return -EINVAL;
+    }
+
+    ret = adxl_pm_get(adxl); // Calibration needs live samples
+    if (ret)
+        return ret;
+    mutex_lock(&adxl->lock);
+    ret = calibrate(adxl, n);
+    mutex_unlock(&adxl->lock);
+    adxl_pm_put(adxl);
+
+    if (ret) {
+        dev_err(dev, "Calibration failed: %d\n", ret);
+        return ret;
+    }
+    return count;
+}
+
+// sysfs - Estimated real sample period from the timestamp estimator
+static ssize_t sample_period_ns_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    unsigned long flags;
+    u64 period_q;
+
+    if (!adxl) 
+        return -ENODEV;
+    spin_lock_irqsave(&adxl->data_lock, flags);
+    period_q = adxl->ts_period_q;
+    spin_unlock_irqrestore(&adxl->data_lock, flags);
+    return sprintf(buf, "%llu\n", period_q >> TS_Q);
+}
+
+// sysfs - Sensor clock error vs the nominal ODR in ppm (positive = sensor runs slow)
+static ssize_t clock_drift_ppm_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    if (!adxl) 
+        return -ENODEV;
+    return sprintf(buf, "%lld\n", ts_drift_ppm(adxl));
+}
+
+// sysfs - Records lost because a stream was not drained
+static ssize_t events_dropped_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    if (!adxl) 
+        return -ENODEV;
+    return sprintf(buf, "%u\n", READ_ONCE(adxl->events.dropped));
+}
+
+static ssize_t samples_dropped_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    if (!adxl) 
+        return -ENODEV;
+    return sprintf(buf, "%u %u\n", READ_ONCE(adxl->samples.dropped), READ_ONCE(adxl->raw.dropped));
+}
+
+// sysfs - Samples averaged per record on /dev/adxl345_samples (1 = full rate)
+static ssize_t decimation_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    if (!adxl) 
+        return -ENODEV;
+    return sprintf(buf, "%u\n", READ_ONCE(adxl->decimation));
+}
+
+static ssize_t decimation_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    unsigned int val;
+    int ret;
+
+    if (!adxl) return -ENODEV;
+
+    ret = kstrtouint(buf, 0, &val);
+    if (ret)
+        return ret;
+    if (val < 1 || val > DECIMATION_MAX) {
+        dev_err(dev, "Invalid decimation %u. Must be 1 - %u.\n", val, DECIMATION_MAX);
+        return -EINVAL;
+    }
+    WRITE_ONCE(adxl->decimation, val);
     return count;
 }
 
+// sysfs - Capture control: write 1 to arm (re-arm after reading), 0 to stop
+static const char * const capture_state_names[] = {
+    [CAPTURE_OFF] = "off",
+    [CAPTURE_ARMED] = "armed",
+    [CAPTURE_TRIGGERED] = "triggered",
+    [CAPTURE_READY] = "ready",
+};
+
+static ssize_t capture_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    if (!adxl) 
+        return -ENODEV;
+    return sprintf(buf, "%s\n", capture_state_names[READ_ONCE(adxl->capture_state)]);
+}
+
+static ssize_t capture_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev);
+    bool arm, put;
+    int ret = 0;
+
+    if (!adxl) return -ENODEV;
+
+    ret = kstrtobool(buf, &arm);
+    if (ret)
+        return ret;
+
+    // An armed capture keeps the sensor measuring with no reader attached, until disarmed
+    if (arm) {
+        ret = adxl_pm_get(adxl);
+        if (ret)
+            return ret;
+    }
+    mutex_lock(&adxl->lock);
+    if (arm) {
+        ret = capture_arm(adxl);
+        put = ret || adxl->capture_pm; // Re-arm keeps the reference it already holds
+        if (!ret)
+            adxl->capture_pm = true;
+    } else {
+        capture_disarm(adxl);
+        put = adxl->capture_pm;
+        adxl->capture_pm = false;
+    }
+    mutex_unlock(&adxl->lock);
+    if (put)
+        adxl_pm_put(adxl);
+
+    return ret ? ret : count;
+}
+
+// sysfs - Capture settings, applied on the next arm (triggers and threshold immediately)
+#define ADXL_CAPTURE_ATTR(_name) \
+static ssize_t _name##_show(struct device *dev, struct device_attribute *attr, char *buf) { \
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev); \
+    if (!adxl) \
+        return -ENODEV; \
+    return sprintf(buf, "%u\n", READ_ONCE(adxl->_name)); \
+} \
+static ssize_t _name##_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) { \
+    struct my_ADXL345 *adxl = dev_get_drvdata(dev); \
+    unsigned int val; \
+    int ret; \
+    if (!adxl) return -ENODEV; \
+    ret = kstrtouint(buf, 0, &val); \
+    if (ret) \
+        return ret; \
+    WRITE_ONCE(adxl->_name, val); \
+    return count; \
+} \
+static DEVICE_ATTR_RW(_name)
+
+ADXL_CAPTURE_ATTR(capture_pre_ms);
+ADXL_CAPTURE_ATTR(capture_post_ms);
+ADXL_CAPTURE_ATTR(capture_threshold_mg);
+ADXL_CAPTURE_ATTR(capture_triggers); // BIT(ADXL345_EV_*) mask
+
+// sysfs - Frozen capture window as one blob (see adxl345_uapi.h), empty until ready
+static ssize_t capture_data_read(struct file *filp, struct kobject *kobj, struct bin_attribute *attr,
+                                 char *buf, loff_t off, size_t count) {
+    struct my_ADXL345 *adxl = dev_get_drvdata(kobj_to_dev(kobj));
+    if (!adxl) 
+        return -ENODEV;
+    return capture_copy(adxl, buf, off, count);
+}
+
+static BIN_ATTR_RO(capture_data, 0);
+
 static DEVICE_ATTR_RW(range); // Uses S_IRUGO | S_IWUSR by default
 static DEVICE_ATTR_RW(rate);
+static struct device_attribute dev_attr_sampling_frequency =
+    __ATTR(sampling_frequency, 0644, rate_show, rate_store);
+static DEVICE_ATTR_RO(sampling_frequency_available);
+static DEVICE_ATTR_RW(low_power);
+static DEVICE_ATTR_RO(measured_rate);
+static DEVICE_ATTR_RW(double_tap_cooldown_ms);
+static DEVICE_ATTR_RW(offset);
+static DEVICE_ATTR_WO(calibrate);
+static DEVICE_ATTR_RO(sample_period_ns);
+static DEVICE_ATTR_RO(clock_drift_ppm);
+static DEVICE_ATTR_RO(events_dropped);
+static DEVICE_ATTR_RO(samples_dropped);
+static DEVICE_ATTR_RW(decimation);
+static DEVICE_ATTR_RW(auto_sleep);
+static DEVICE_ATTR_RO(idle);
+static DEVICE_ATTR_RO(sleep_count);
+static DEVICE_ATTR_RO(idle_time_ms);
+static DEVICE_ATTR_RO(avoided_irqs);
+static DEVICE_ATTR_RO(avoided_spi_bytes);
+static DEVICE_ATTR_RW(capture);
 
 static struct attribute *adxl345_attrs[] = {
     &dev_attr_range.attr,
     &dev_attr_rate.attr,
+    &dev_attr_sampling_frequency.attr,
+    &dev_attr_sampling_frequency_available.attr,
+    &dev_attr_low_power.attr,
+    &dev_attr_measured_rate.attr,
+    &dev_attr_tap_threshold_mg.attr.attr,
+    &dev_attr_tap_duration_us.attr.attr,
+    &dev_attr_tap_latency_us.attr.attr,
+    &dev_attr_tap_window_us.attr.attr,
+    &dev_attr_double_tap_cooldown_ms.attr,
+    &dev_attr_offset.attr,
+    &dev_attr_calibrate.attr,
+    &dev_attr_sample_period_ns.attr,
+    &dev_attr_clock_drift_ppm.attr,
+    &dev_attr_events_dropped.attr,
+    &dev_attr_samples_dropped.attr,
+    &dev_attr_decimation.attr,
+    &dev_attr_activity_threshold_mg.attr.attr,
+    &dev_attr_inactivity_threshold_mg.attr.attr,
+    &dev_attr_inactivity_time_s.attr.attr,
+    &dev_attr_act_inact_ctl.attr.attr,
+    &dev_attr_auto_sleep.attr,
+    &dev_attr_idle.attr,
+    &dev_attr_sleep_count.attr,
+    &dev_attr_idle_time_ms.attr,
+    &dev_attr_avoided_irqs.attr,
+    &dev_attr_avoided_spi_bytes.attr,
+    &dev_attr_capture.attr,
+    &dev_attr_capture_pre_ms.attr,
+    &dev_attr_capture_post_ms.attr,
+    &dev_attr_capture_threshold_mg.attr,
+    &dev_attr_capture_triggers.attr,
+    NULL,
+};
+
+static struct bin_attribute *adxl345_bin_attrs[] = {
+    &bin_attr_capture_data,
     NULL,
 };
 
 static const struct attribute_group adxl345_attr_group = {
     .attrs = adxl345_attrs,
+    .bin_attrs = adxl345_bin_attrs,
 };
 
 // Char Device file operations
@@ -138,10 +700,11 @@ static int adxl345_open(struct inode *inode, struct file *file) {
         return -ENODEV;
     }
     file->private_data = adxl;
-    return 0;
+    return adxl_file_get(adxl); // Out of standby while the device is open
 }
 
 static int adxl345_release(struct inode *inode, struct file *file) {
+    adxl_file_put(file->private_data);
     return 0;
 }
 
@@ -151,24 +714,39 @@ static ssize_t adxl345_read(struct file *file, char __user *ubuf, size_t user_co
     int data_len_in_buffer = 0;
     int get_data_ret;
     ssize_t bytes_copied = 0;
+    unsigned long flags;
+    s16 x, y, z;
 
-    if (!adxl || !adxl->spi) return -ENODEV;
+    if (!adxl || !adxl->spi || READ_ONCE(adxl->dead)) return -ENODEV;
     if (user_count == 0) return 0;
 
     if (adxl->irq >= 0) 
         disable_irq(adxl->irq);
     mutex_lock(&adxl->lock);
+    if (adxl->dead) { // Unbound while waiting for the lock
+        mutex_unlock(&adxl->lock);
+        if (adxl->irq >= 0)
+            enable_irq(adxl->irq);
+        return -ENODEV;
+    }
 
-    // Fetch fresh sensor data on each read
-    get_data_ret = get_data(adxl);
-    if (get_data_ret) 
-        dev_err(adxl->dev, "READ: get_data() failed: %d\n", get_data_ret);
+    // Fetch fresh sensor data on each read. In FIFO mode a read would pop an entry from
+    // under the IIO buffer, report the newest sample the interrupt path stored instead.
+    if (!READ_ONCE(adxl->fifo_watermark)) {
+        get_data_ret = get_data(adxl);
+        if (get_data_ret) 
+            dev_err(adxl->dev, "READ: get_data() failed: %d\n", get_data_ret);
+    }
 
-    data_len_in_buffer = scnprintf(local_buffer, sizeof(local_buffer),
-                                   "X: %d\nY: %d\nZ: %d\n",
-                                   adxl->x, adxl->y, adxl->z);
+    spin_lock_irqsave(&adxl->data_lock, flags);
+    x = adxl->x;
+    y = adxl->y;
+    z = adxl->z;
+    spin_unlock_irqrestore(&adxl->data_lock, flags);
 
     mutex_unlock(&adxl->lock);
+    data_len_in_buffer = scnprintf(local_buffer, sizeof(local_buffer),
+                                   "X: %d\nY: %d\nZ: %d\n", x, y, z);
     if (adxl->irq >= 0) 
         enable_irq(adxl->irq);
 
@@ -195,36 +773,76 @@ static const struct file_operations adxl345_fops = {
 
 static int interface_init(struct my_ADXL345 *adxl, struct spi_device *spi)
 {
+    struct device *dev;
     int ret;
 
     // Register Character Device
-    ret = alloc_chrdev_region(&adxl->dev_num, 0, 1, DEVICE_NAME);
+    ret = alloc_chrdev_region(&adxl->dev_num, 0, ADXL_MINORS, DEVICE_NAME); // Data + streams
     if (ret < 0) { 
         dev_err(adxl->dev, "alloc_chrdev_region failed: %d\n", ret); 
         return ret; 
     }
     adxl->dev_class = class_create(CLASS_NAME);
     if (IS_ERR(adxl->dev_class)) {
-        return PTR_ERR(adxl->dev_class); 
+        ret = PTR_ERR(adxl->dev_class);
+        goto err_region;
     }
-    if (!device_create(adxl->dev_class, &spi->dev, adxl->dev_num, adxl, DEVICE_NAME)) { 
-        return -EFAULT; 
+    dev = device_create(adxl->dev_class, &spi->dev, adxl->dev_num, adxl, DEVICE_NAME);
+    if (IS_ERR(dev)) { 
+        ret = PTR_ERR(dev);
+        goto err_class;
     }
     cdev_init(&adxl->cdev, &adxl345_fops);
+    cdev_set_parent(&adxl->cdev, &adxl->kobj);
     ret = cdev_add(&adxl->cdev, adxl->dev_num, 1);
     if (ret < 0) {
-        return ret; 
+        goto err_device;
     }
     // dev_info(adxl->dev, "/dev/%s created\n", DEVICE_NAME); 
+    ret = stream_init(adxl, &adxl->events, ADXL_MINOR_EVENTS, EVENT_DEVICE_NAME,
+                      sizeof(struct adxl345_event), EVENT_FIFO_SIZE);
+    if (ret) {
+        dev_err(adxl->dev, "Event device init failed: %d\n", ret);
+        goto err_cdev;
+    }
+    ret = stream_init(adxl, &adxl->samples, ADXL_MINOR_SAMPLES, SAMPLE_DEVICE_NAME,
+                      sizeof(struct adxl345_sample), SAMPLE_FIFO_SIZE);
+    if (ret) {
+        dev_err(adxl->dev, "Sample device init failed: %d\n", ret);
+        goto err_events;
+    }
+    ret = stream_init(adxl, &adxl->raw, ADXL_MINOR_RAW, RAW_DEVICE_NAME,
+                      sizeof(struct adxl345_sample), RAW_FIFO_SIZE);
+    if (ret) {
+        dev_err(adxl->dev, "Raw sample device init failed: %d\n", ret);
+        goto err_samples;
+    }
     // Register Sysfs attributes
     ret = sysfs_create_group(&spi->dev.kobj, &adxl345_attr_group);
     if (ret) { 
         dev_err(adxl->dev, "sysfs_create_group failed: %d\n", ret); 
-        return ret;
+        goto err_raw;
     }
     // dev_info(adxl->dev, "Sysfs attributes created\n"); 
 
     return 0;
+
+    // Unwind in reverse, or the class and region stay behind and the next probe fails
+err_raw:
+    stream_cleanup(adxl, &adxl->raw);
+err_samples:
+    stream_cleanup(adxl, &adxl->samples);
+err_events:
+    stream_cleanup(adxl, &adxl->events);
+err_cdev:
+    cdev_del(&adxl->cdev);
+err_device:
+    device_destroy(adxl->dev_class, adxl->dev_num);
+err_class:
+    class_destroy(adxl->dev_class);
+err_region:
+    unregister_chrdev_region(adxl->dev_num, ADXL_MINORS);
+    return ret;
 }
 
 static void interface_cleanup(struct my_ADXL345 *adxl, struct spi_device *spi)
@@ -234,10 +852,13 @@ static void interface_cleanup(struct my_ADXL345 *adxl, struct spi_device *spi)
     dev_info(&spi->dev, "Sysfs attributes removed\n");
 
     // Character Device Unregistration
+    stream_cleanup(adxl, &adxl->raw);
+    stream_cleanup(adxl, &adxl->samples);
+    stream_cleanup(adxl, &adxl->events);
     cdev_del(&adxl->cdev);
     device_destroy(adxl->dev_class, adxl->dev_num);
     class_destroy(adxl->dev_class);
-    unregister_chrdev_region(adxl->dev_num, 1);
+    unregister_chrdev_region(adxl->dev_num, ADXL_MINORS);
     dev_info(&spi->dev, "Character device removed\n");
 }
 #endif
\ No newline at end of file
@@ -1,73 +1,420 @@
 #ifndef INTERRUPTS_H
 #include "ADXL345_spi.h"
 
-static irqreturn_t irq_handler(int irq, void *dev_id) {
-    struct my_ADXL345 *adxl = (struct my_ADXL345 *)dev_id;
-    u8 int_source;
-    int ret_val;
+// Issue the INT_SOURCE + data burst unless one is already in flight.
+// Callers set ADXL_XFER_PENDING first; the owner of ADXL_XFER_BUSY consumes it.
+static void irq_submit_burst(struct my_ADXL345 *adxl) {
+    int ret;
 
-    if (!adxl || !adxl->spi) return IRQ_NONE;
+    if (!test_bit(ADXL_XFER_PENDING, &adxl->irq_flags) ||
+        test_bit(ADXL_XFER_STOP, &adxl->irq_flags) ||
+        test_and_set_bit(ADXL_XFER_BUSY, &adxl->irq_flags))
+        return;
+
+    clear_bit(ADXL_XFER_PENDING, &adxl->irq_flags);
+    adxl->burst_fresh = test_and_clear_bit(ADXL_TS_FRESH, &adxl->irq_flags);
+    adxl->burst_submit_ns = ktime_get_ns();
+    adxl->burst_ts = adxl->burst_fresh ? READ_ONCE(adxl->irq_ts) : adxl->burst_submit_ns;
+    ret = spi_async(adxl->spi, &adxl->irq_msg);
+    if (ret) {
+        adxl_stat_inc(adxl, spi_errors);
+        dev_err_ratelimited(adxl->dev, "IRQ: spi_async failed: %d\n", ret);
+        clear_bit(ADXL_XFER_BUSY, &adxl->irq_flags);
+        wake_up_var(&adxl->irq_flags);
+    }
+}
+
+// Average DATA_READY rate over windows of at least one second
+static void update_measured_rate(struct my_ADXL345 *adxl, u64 ts) {
+    u64 elapsed;
+
+    if (!READ_ONCE(adxl->meas_start_ns)) { // First sample, or reset by a rate change
+        adxl->meas_start_ns = ts;
+        adxl->meas_count = 0;
+        return;
+    }
+
+    adxl->meas_count++;
+    elapsed = ts - adxl->meas_start_ns;
+    if (elapsed >= NSEC_PER_SEC) {
+        WRITE_ONCE(adxl->measured_mhz,
+                   (u32)div64_u64((u64)adxl->meas_count * NSEC_PER_SEC * 1000, elapsed));
+        adxl->meas_start_ns = ts;
+        adxl->meas_count = 0;
+    }
+}
+
+// Program INT_ENABLE and keep the cached copy, only cached while runtime suspended or
+// before interrupts_arm(). Caller holds adxl->lock.
+static int set_int_enable(struct my_ADXL345 *adxl, u8 val) {
+    int ret = 0;
+
+    if (!adxl->suspended && !test_bit(ADXL_XFER_STOP, &adxl->irq_flags))
+        ret = write_reg(adxl, REG_INT_ENABLE, val);
+    if (!ret)
+        adxl->int_enable = val;
+    return ret;
+}
+
+// Mask the data interrupt while idle and unmask it on activity (SPI writes can't run in the completion)
+static void power_work_fn(struct work_struct *work) {
+    struct my_ADXL345 *adxl = container_of(work, struct my_ADXL345, power_work);
+    u8 val;
+
+    mutex_lock(&adxl->lock);
+    val = adxl->int_enable;
+    if (READ_ONCE(adxl->idle))
+        val &= ~adxl->data_int;
+    else
+        val |= adxl->data_int;
+    if (val != adxl->int_enable && adxl->auto_sleep)
+        set_int_enable(adxl, val);
+    mutex_unlock(&adxl->lock);
+}
+
+// DATA_READY interrupts the current ODR would have raised over idle_ns
+static u64 idle_irqs(struct my_ADXL345 *adxl, u64 idle_ns) {
+    return div64_u64(div_u64(idle_ns, NSEC_PER_USEC) *
+                     adxl345_odr_mhz[adxl->bw_rate & BW_RATE_RATE_MASK], 1000000000ULL);
+}
+
+// Close out an idle period in progress. Caller holds data_lock.
+static void idle_exit(struct my_ADXL345 *adxl, u64 now) {
+    if (!adxl->idle)
+        return;
+    adxl->idle_total_ns += now - adxl->idle_since_ns;
+    adxl->avoided_irqs += idle_irqs(adxl, now - adxl->idle_since_ns);
+    adxl->idle = false;
+}
+
+// Enable or disable link mode + AUTO_SLEEP with ACTIVITY/INACTIVITY interrupts.
+// Caller holds adxl->lock.
+static int set_auto_sleep(struct my_ADXL345 *adxl, bool enable) {
+    u8 int_enable = (adxl->int_enable & ~(INT_ACTIVITY | INT_INACTIVITY)) | adxl->data_int;
+    u8 power_ctl = POWER_CTL_MEASURE;
+    unsigned long flags;
+    u64 now;
+    int ret;
+
+    if (enable) {
+        int_enable |= INT_ACTIVITY | INT_INACTIVITY;
+        power_ctl |= POWER_CTL_LINK | POWER_CTL_AUTO_SLEEP | POWER_CTL_WAKEUP_8HZ;
+    }
+
+    // Datasheet: change LINK/AUTO_SLEEP in standby, then go back to measurement.
+    // While runtime suspended only the cached values change, resume applies them.
+    if (!adxl->suspended) {
+        ret = write_reg(adxl, REG_POWER_CTL, 0x00);
+        if (ret)
+            return ret;
+    }
+    ret = set_int_enable(adxl, int_enable);
+    if (ret)
+        return ret;
+    if (!adxl->suspended) {
+        ret = write_reg(adxl, REG_POWER_CTL, power_ctl);
+        if (ret)
+            return ret;
+    }
+    adxl->power_ctl = power_ctl;
+
+    // Start awake, close out an idle period that was in progress
+    now = ktime_get_ns();
+    spin_lock_irqsave(&adxl->data_lock, flags);
+    idle_exit(adxl, now);
+    WRITE_ONCE(adxl->auto_sleep, enable);
+    spin_unlock_irqrestore(&adxl->data_lock, flags);
+    return 0;
+}
+
+// Track idle periods from ACTIVITY/INACTIVITY interrupts (completion context)
+static void update_idle_state(struct my_ADXL345 *adxl, u8 int_source, u64 ts) {
+    unsigned long flags;
+
+    if (!READ_ONCE(adxl->auto_sleep))
+        return;
+
+    spin_lock_irqsave(&adxl->data_lock, flags);
+    if ((int_source & INT_INACTIVITY) && !adxl->idle) {
+        adxl->idle = true;
+        adxl->idle_since_ns = ts;
+        adxl->sleep_count++;
+    } else if ((int_source & INT_ACTIVITY) && adxl->idle) {
+        ts_reset(adxl); // Samples resume after a gap, don't count it as missed
+        idle_exit(adxl, ts);
+    } else {
+        spin_unlock_irqrestore(&adxl->data_lock, flags);
+        return;
+    }
+    spin_unlock_irqrestore(&adxl->data_lock, flags);
+
+    schedule_work(&adxl->power_work);
+}
+
+// Deliver an event to the event queue and the capture trigger
+static void report_event(struct my_ADXL345 *adxl, u32 type, u8 int_source, u64 ts) {
+    push_event(adxl, type, int_source, ts);
+    capture_event(adxl, type, ts);
+}
+
+// Hand one DATAX0..DATAZ1 sample to every consumer (completion context)
+static void process_sample(struct my_ADXL345 *adxl, const u8 *raw, u64 sample_ts) {
+    struct adxl345_sample s;
+
+    adxl_stat_inc(adxl, samples);
+    store_sample(adxl, raw);
+    capture_sample(adxl, raw, sample_ts);
+    decimate_sample(adxl, raw, sample_ts);
+    update_measured_rate(adxl, sample_ts);
+
+    if (READ_ONCE(adxl->iio_active)) { // The IIO pollfunc drains these (iio.h)
+        s.timestamp_ns = sample_ts;
+        s.x = (s16)((raw[1] << 8) | raw[0]);
+        s.y = (s16)((raw[3] << 8) | raw[2]);
+        s.z = (s16)((raw[5] << 8) | raw[4]);
+        s.reserved = 0;
+        if (!kfifo_put(&adxl->iio_fifo, s))
+            adxl_stat_inc(adxl, ring_overruns);
+    }
+}
 
-    ret_val = read_reg(adxl->spi, REG_INT_SOURCE, &int_source); // Clears ADXL345 IRQ flags
-    if (ret_val) {
-        dev_err(adxl->dev, "IRQ: Error reading INT_SOURCE: %d\n", ret_val);
-        return IRQ_NONE;
+// Release the burst message and issue the next one if INT1 is still asserted
+static void irq_burst_done(struct my_ADXL345 *adxl) {
+    if (READ_ONCE(adxl->iio_active) && !kfifo_is_empty(&adxl->iio_fifo))
+        irq_work_queue(&adxl->iio_work);
+
+    clear_bit(ADXL_XFER_BUSY, &adxl->irq_flags);
+    smp_mb__after_atomic();
+    wake_up_var(&adxl->irq_flags);
+
+    // INT1 is edge triggered: if it is still asserted no new edge will come
+    if (gpio_get_value(adxl->int1_gpio))
+        set_bit(ADXL_XFER_PENDING, &adxl->irq_flags);
+    irq_submit_burst(adxl);
+}
+
+// SPI completion for the FIFO drain: entries 0..fifo_n-1, oldest first
+static void irq_fifo_complete(void *context) {
+    struct my_ADXL345 *adxl = context;
+    unsigned int i, n = adxl->fifo_n;
+    u64 first, now = ktime_get_ns();
+
+    stats_xfer_time(adxl, adxl->fifo_submit_ns, now);
+    if (adxl->burst_fresh)
+        stats_irq_latency(adxl, adxl->burst_ts, now);
+    if (adxl->fifo_msg.status) {
+        adxl_stat_inc(adxl, spi_errors);
+        dev_err_ratelimited(adxl->dev, "IRQ: FIFO read failed: %d\n", adxl->fifo_msg.status);
+        n = 1; // Entry 0 came with the burst
+    }
+
+    // The watermark edge marks the arrival of the newest entry of the batch
+    first = ts_batch(adxl, n, adxl->burst_ts, adxl->burst_fresh);
+    for (i = 0; i < n; i++)
+        process_sample(adxl, &adxl->fifo_rx[i][1], ts_sample(adxl, first, i));
+
+    irq_burst_done(adxl);
+}
+
+// Read the rest of a watermark batch; the burst already popped entry 0.
+// Returns false if the drain could not be issued.
+static bool irq_submit_fifo(struct my_ADXL345 *adxl, unsigned int n) {
+    unsigned int i;
+
+    memcpy(&adxl->fifo_rx[0][1], &adxl->irq_rx[IRQ_BURST_DATA], 6);
+    adxl->fifo_n = n;
+    for (i = 1; i < n; i++)
+        adxl->fifo_xfer[i].cs_change = i < n - 1; // Release CS between entries, not after the last
+
+    // [0] only waits out the pop of the entry the burst read
+    spi_message_init_with_transfers(&adxl->fifo_msg, adxl->fifo_xfer, n);
+    adxl->fifo_msg.complete = irq_fifo_complete;
+    adxl->fifo_msg.context = adxl;
+    adxl->fifo_submit_ns = ktime_get_ns();
+    if (spi_async(adxl->spi, &adxl->fifo_msg)) {
+        adxl_stat_inc(adxl, spi_errors);
+        dev_err_ratelimited(adxl->dev, "IRQ: FIFO spi_async failed\n");
+        return false;
+    }
+    return true;
+}
+
+// SPI completion for the interrupt burst (may run in atomic context)
+static void irq_burst_complete(void *context) {
+    struct my_ADXL345 *adxl = context;
+    u64 ts = adxl->burst_ts;
+    u64 sample_ts, now = ktime_get_ns();
+    u8 int_source, wm;
+
+    stats_xfer_time(adxl, adxl->burst_submit_ns, now);
+    if (adxl->irq_msg.status) {
+        adxl_stat_inc(adxl, spi_errors);
+        dev_err_ratelimited(adxl->dev, "IRQ: burst read failed: %d\n", adxl->irq_msg.status);
+        goto out;
     }
 
+    int_source = adxl->irq_rx[IRQ_BURST_INT_SOURCE]; // Read cleared ADXL345 IRQ flags
     if (int_source == 0) { // No relevant flags set, or spurious
-        // dev_warn(adxl->dev, "IRQ: INT_SOURCE was 0x00 after read.\n"); // Optional: for debugging noise
-        return IRQ_HANDLED;
+        adxl_stat_inc(adxl, empty_irqs);
+        goto out;
     }
+    if (int_source & INT_OVERRUN)
+        adxl_stat_inc(adxl, fifo_overruns);
 
     if (int_source != 0x82){
         dev_dbg(adxl->dev, "IRQ: INT_SOURCE raw: 0x%02x\n", int_source); // Log what caused it
     }
 
+    // Events go to /dev/adxl345_events, no printk on this path
     if (int_source & INT_DOUBLE_TAP) {
-        dev_info(adxl->dev, "IRQ: DOUBLE_TAP detected!\n");
-        adxl->last_double_tap_jiffies = jiffies;
+        report_event(adxl, ADXL345_EV_DOUBLE_TAP, int_source, ts);
+        adxl->last_double_tap_ns = ts;
     } else if (int_source & INT_SINGLE_TAP) {
-        if (time_before(jiffies, adxl->last_double_tap_jiffies + msecs_to_jiffies(DOUBLE_TAP_COOLDOWN_MS))) {
+        if (ts - adxl->last_double_tap_ns <
+            (u64)READ_ONCE(adxl->double_tap_cooldown_ms) * NSEC_PER_MSEC) {
             dev_dbg(adxl->dev, "IRQ: SINGLE_TAP (ignored: cooldown)\n");
         } else {
-            dev_info(adxl->dev, "IRQ: SINGLE_TAP detected!\n");
+            report_event(adxl, ADXL345_EV_SINGLE_TAP, int_source, ts);
         }
     }
+    if (int_source & INT_ACTIVITY)
+        report_event(adxl, ADXL345_EV_ACTIVITY, int_source, ts);
+    if (int_source & INT_INACTIVITY)
+        report_event(adxl, ADXL345_EV_INACTIVITY, int_source, ts);
+    if (int_source & INT_FREE_FALL)
+        report_event(adxl, ADXL345_EV_FREE_FALL, int_source, ts);
+    if (int_source & (INT_ACTIVITY | INT_INACTIVITY))
+        update_idle_state(adxl, int_source, ts);
 
+    // Data registers were read in the same burst, no second transaction needed.
+    // In FIFO mode that read popped the oldest entry, a watermark batch reads the rest.
     if (int_source & INT_DATA_READY) {
-        mutex_lock(&adxl->lock);
-        ret_val = get_data(adxl);
-        if (ret_val) {
-            dev_err(adxl->dev, "IRQ: get_data() failed in DATA_READY: %d\n", ret_val);
-        }
-        mutex_unlock(&adxl->lock);
+        wm = READ_ONCE(adxl->fifo_watermark);
+        if (wm && (int_source & INT_WATERMARK) && irq_submit_fifo(adxl, wm))
+            return; // irq_fifo_complete() finishes the burst
+        if (adxl->burst_fresh && !wm)
+            stats_irq_latency(adxl, ts, now);
+        // A lone FIFO entry is older than the edge that brought us here
+        sample_ts = ts_batch(adxl, 1, ts, adxl->burst_fresh && !wm);
+        process_sample(adxl, &adxl->irq_rx[IRQ_BURST_DATA], sample_ts);
     }
 
+out:
+    irq_burst_done(adxl);
+}
+
+// Switch between DATA_READY per sample (wm <= 1) and FIFO stream mode with a watermark
+// interrupt every wm samples. Caller holds adxl->lock.
+static int set_fifo_watermark(struct my_ADXL345 *adxl, unsigned int wm) {
+    u8 data_int = wm > 1 ? INT_WATERMARK : INT_DATA_READY;
+    u8 int_enable = adxl->int_enable & ~(INT_DATA_READY | INT_WATERMARK);
+    int ret;
+
+    if (adxl->int_enable & adxl->data_int) // Keep it masked if idle
+        int_enable |= data_int;
+
+    WRITE_ONCE(adxl->fifo_watermark, 0); // Bursts in flight stop draining
+    ret = write_reg(adxl, REG_FIFO_CTL, FIFO_CTL_BYPASS); // Also empties the FIFO
+    if (ret)
+        return ret;
+    if (wm > 1) {
+        ret = write_reg(adxl, REG_FIFO_CTL, FIFO_CTL_STREAM | (wm & FIFO_CTL_SAMPLES_MASK));
+        if (ret)
+            return ret;
+    }
+    ret = set_int_enable(adxl, int_enable);
+    if (ret)
+        return ret;
+    adxl->data_int = data_int;
+    ts_reset(adxl); // Batches from here on, don't count the switch as missed samples
+    WRITE_ONCE(adxl->fifo_watermark, wm > 1 ? wm : 0);
+    return 0;
+}
+
+// Hard IRQ: only queue the burst, the completion does the bookkeeping
+static irqreturn_t irq_handler(int irq, void *dev_id) {
+    struct my_ADXL345 *adxl = (struct my_ADXL345 *)dev_id;
+
+    if (!adxl || !adxl->spi) return IRQ_NONE;
+
+    WRITE_ONCE(adxl->irq_ts, ktime_get_ns());
+    adxl_stat_inc(adxl, irqs);
+    smp_mb__before_atomic();
+    set_bit(ADXL_TS_FRESH, &adxl->irq_flags);
+    set_bit(ADXL_XFER_PENDING, &adxl->irq_flags);
+    irq_submit_burst(adxl);
+
     return IRQ_HANDLED;
 }
 
+// Sets everything up but leaves the chip's interrupts masked and bursts stopped: the
+// completion feeds the streams and IIO, interrupts_arm() starts it once they exist.
 static int interrupt_init(struct my_ADXL345 *adxl, struct spi_device *spi)
 {
     int irq_num, ret;
 
+    set_bit(ADXL_XFER_STOP, &adxl->irq_flags);
+    ret = write_reg(adxl, REG_INT_ENABLE, 0x00); // May still be set by an earlier load
+    if (ret)
+        return ret;
+
     // Configure Tap Detection Registers
     // dev_info(adxl->dev, "Configuring Tap Detection...\n"); // Minimal
-    ret = write_reg(spi, REG_THRESH_TAP, 0x40); 
+    ret = write_reg(adxl, REG_THRESH_TAP, 0x40); 
     if (ret) 
         return ret; // ~4g threshold (tune). Desired / 0.065 = THRESH
-    ret = write_reg(spi, REG_DUR, 0x20);        
+    ret = write_reg(adxl, REG_DUR, 0x20);        
     if (ret) 
         return ret; // ~20ms duration (tune)
-    ret = write_reg(spi, REG_LATENT, 0x50);     
+    ret = write_reg(adxl, REG_LATENT, 0x50);     
     if (ret) 
         return ret; // 100ms latency (tune)
-    ret = write_reg(spi, REG_WINDOW, 0xF0);     
+    ret = write_reg(adxl, REG_WINDOW, 0xF0);     
     if (ret) 
         return ret; // 300ms window (tune)
-    ret = write_reg(spi, REG_TAP_AXES, 0x07);   
+    ret = write_reg(adxl, REG_TAP_AXES, 0x07);   
     if (ret) 
         return ret; // Enable X,Y,Z tap
 
+    // Activity/inactivity detection, only routed once auto_sleep is enabled
+    ret = write_reg(adxl, REG_THRESH_ACT, THRESH_ACT_DEFAULT);
+    if (ret) 
+        return ret;
+    ret = write_reg(adxl, REG_THRESH_INACT, THRESH_INACT_DEFAULT);
+    if (ret) 
+        return ret;
+    ret = write_reg(adxl, REG_TIME_INACT, TIME_INACT_DEFAULT);
+    if (ret) 
+        return ret;
+    ret = write_reg(adxl, REG_ACT_INACT_CTL, ACT_INACT_CTL_ALL_AC);
+    if (ret) 
+        return ret;
+    INIT_WORK(&adxl->power_work, power_work_fn);
+
+    // Prebuilt burst message: INT_SOURCE, DATA_FORMAT, DATAX0..DATAZ1 in one CS cycle
+    memset(adxl->irq_tx, 0, sizeof(adxl->irq_tx));
+    adxl->irq_tx[0] = REG_INT_SOURCE | 0x80 | 0x40; // Multi-byte read
+    adxl->irq_xfer.tx_buf = adxl->irq_tx;
+    adxl->irq_xfer.rx_buf = adxl->irq_rx;
+    adxl->irq_xfer.len = IRQ_BURST_LEN;
+    spi_message_init_with_transfers(&adxl->irq_msg, &adxl->irq_xfer, 1);
+    adxl->irq_msg.complete = irq_burst_complete;
+    adxl->irq_msg.context = adxl;
+
+    // FIFO drain transfers, the message is assembled per batch in irq_submit_fifo()
+    memset(adxl->fifo_tx, 0, sizeof(adxl->fifo_tx));
+    adxl->fifo_tx[0] = REG_DATAX0 | 0x80 | 0x40;
+    adxl->fifo_xfer[0].delay.value = FIFO_POP_DELAY_US;
+    adxl->fifo_xfer[0].delay.unit = SPI_DELAY_UNIT_USECS;
+    for (int i = 1; i < FIFO_WATERMARK_MAX; i++) {
+        adxl->fifo_xfer[i].tx_buf = adxl->fifo_tx;
+        adxl->fifo_xfer[i].rx_buf = adxl->fifo_rx[i];
+        adxl->fifo_xfer[i].len = FIFO_ENTRY_LEN;
+        adxl->fifo_xfer[i].delay.value = FIFO_POP_DELAY_US;
+        adxl->fifo_xfer[i].delay.unit = SPI_DELAY_UNIT_USECS;
+    }
+    adxl->data_int = INT_DATA_READY;
+
     // Setup Kernel-Side Interrupt Handling
     struct device_node *node = spi->dev.of_node;
     if (!node) { 
@@ -95,8 +442,8 @@ static int interrupt_init(struct my_ADXL345 *adxl, struct spi_device *spi)
     adxl->irq = irq_num;
     dev_info(adxl->dev, "GPIO %d mapped to IRQ %d\n", adxl->int1_gpio, adxl->irq); 
 
-    ret = devm_request_threaded_irq(&spi->dev, adxl->irq, NULL, irq_handler,
-                                   IRQF_TRIGGER_RISING | IRQF_ONESHOT, DEVICE_NAME, adxl);
+    ret = devm_request_irq(&spi->dev, adxl->irq, irq_handler,
+                           IRQF_TRIGGER_RISING, DEVICE_NAME, adxl);
     if (ret) { dev_err(adxl->dev, "Request IRQ %d failed: %d\n", adxl->irq, ret); adxl->irq = -1; 
         return ret; 
     }
@@ -105,30 +452,46 @@ static int interrupt_init(struct my_ADXL345 *adxl, struct spi_device *spi)
     // Configure ADXL345 Interrupt Output (if kernel IRQ setup succeeded)
     if (adxl->irq >= 0) {
         // dev_info(adxl->dev, "Configuring ADXL345 HW interrupts...\n"); 
-        ret = write_reg(spi, REG_INT_MAP, 0x00); 
+        ret = write_reg(adxl, REG_INT_MAP, 0x00); 
         if (ret) 
             return ret; // Route all to INT1
 
-        u8 int_enable_flags = INT_DATA_READY | INT_SINGLE_TAP | INT_DOUBLE_TAP;
-        ret = write_reg(spi, REG_INT_ENABLE, int_enable_flags); 
-        if (ret) 
-            return ret;
+        // Cached only, written by interrupts_arm()
+        adxl->int_enable = INT_DATA_READY | INT_SINGLE_TAP | INT_DOUBLE_TAP;
     } else {
         dev_warn(adxl->dev, "Kernel IRQ not set, disabling ADXL345 HW interrupts.\n");
-        write_reg(spi, REG_INT_ENABLE, 0x00);
+        write_reg(adxl, REG_INT_ENABLE, 0x00);
     }
 
     return 0;
 }
 
+// Unmask the interrupts cached so far and let bursts run. Consumers must be ready.
+static int interrupts_arm(struct my_ADXL345 *adxl)
+{
+    int ret = 0;
+
+    if (adxl->irq < 0)
+        return 0;
+    mutex_lock(&adxl->lock);
+    clear_bit(ADXL_XFER_STOP, &adxl->irq_flags);
+    if (!adxl->suspended)
+        ret = write_reg(adxl, REG_INT_ENABLE, adxl->int_enable);
+    mutex_unlock(&adxl->lock);
+    return ret;
+}
+
 static void interrupts_cleanup(struct my_ADXL345 *adxl, struct spi_device *spi)
 {
         if (adxl->spi) { // Check if spi pointer is valid
-        write_reg(adxl->spi, REG_INT_ENABLE, 0x00); // Stop ADXL345 from generating interrupts
+        set_bit(ADXL_XFER_STOP, &adxl->irq_flags); // No new bursts from here on
+        write_reg(adxl, REG_INT_ENABLE, 0x00); // Stop ADXL345 from generating interrupts
+        wait_var_event(&adxl->irq_flags, !test_bit(ADXL_XFER_BUSY, &adxl->irq_flags));
+        cancel_work_sync(&adxl->power_work);
         dev_info(&spi->dev, "ADXL345 interrupts disabled\n");
 
         // Power down the ADXL345 (optional, good practice)
-        write_reg(adxl->spi, REG_POWER_CTL, 0x00); // Put in standby mode
+        write_reg(adxl, REG_POWER_CTL, 0x00); // Put in standby mode
         dev_info(&spi->dev, "ADXL345 powered down to standby\n");
     }
 }
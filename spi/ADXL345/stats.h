@@ -0,0 +1,113 @@
+#ifndef STATS_H
+#define STATS_H
+#include "ADXL345_spi.h"
+
+// Per-device counters and latency histograms in debugfs (/sys/kernel/debug/adxl345-<spi dev>/).
+// Per-CPU and lockless so they can stay on in production: the hot path is a this_cpu_inc(),
+// reads sum over all CPUs. Writing anything to "reset" zeroes them.
+
+// Histogram bucket for a duration in ns: floor(log2(us)) + 1, 0 below 1 us
+static unsigned int stats_bucket(u64 ns) {
+    u64 us = div_u64(ns, NSEC_PER_USEC);
+
+    return min_t(unsigned int, fls64(us), STATS_HIST_BUCKETS - 1);
+}
+
+// INT1 edge to sample data in hand (completion context)
+static void stats_irq_latency(struct my_ADXL345 *adxl, u64 edge_ns, u64 now) {
+    this_cpu_inc(adxl->stats->latency_hist[stats_bucket(now - edge_ns)]);
+}
+
+// Duration of one SPI message, submit to completion (completion context)
+static void stats_xfer_time(struct my_ADXL345 *adxl, u64 start_ns, u64 now) {
+    this_cpu_inc(adxl->stats->xfer_hist[stats_bucket(now - start_ns)]);
+}
+
+// Sum one counter over all CPUs
+#define STATS_SUM(adxl, field) ({                                   \
+    u64 __sum = 0;                                                  \
+    int __cpu;                                                      \
+    for_each_possible_cpu(__cpu)                                    \
+        __sum += per_cpu_ptr((adxl)->stats, __cpu)->field;          \
+    __sum;                                                          \
+})
+
+static int stats_show(struct seq_file *m, void *v) {
+    struct my_ADXL345 *adxl = m->private;
+
+    seq_printf(m, "irqs: %llu\n", STATS_SUM(adxl, irqs));
+    seq_printf(m, "empty_irqs: %llu\n", STATS_SUM(adxl, empty_irqs));
+    seq_printf(m, "samples: %llu\n", STATS_SUM(adxl, samples));
+    seq_printf(m, "fifo_overruns: %llu\n", STATS_SUM(adxl, fifo_overruns));
+    seq_printf(m, "ring_overruns: %llu\n", STATS_SUM(adxl, ring_overruns));
+    seq_printf(m, "spi_errors: %llu\n", STATS_SUM(adxl, spi_errors));
+    seq_printf(m, "missed_samples: %llu\n", READ_ONCE(adxl->ts_missed));
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(stats);
+
+static void stats_show_hist(struct seq_file *m, struct my_ADXL345 *adxl, size_t offset) {
+    unsigned int b;
+    u64 count;
+    int cpu;
+
+    for (b = 0; b < STATS_HIST_BUCKETS; b++) {
+        count = 0;
+        for_each_possible_cpu(cpu)
+            count += ((u32 *)((u8 *)per_cpu_ptr(adxl->stats, cpu) + offset))[b];
+        if (b == 0)
+            seq_printf(m, "     <1us: %llu\n", count);
+        else if (b == STATS_HIST_BUCKETS - 1)
+            seq_printf(m, ">=%6uus: %llu\n", 1U << (b - 1), count);
+        else
+            seq_printf(m, "  <%6uus: %llu\n", 1U << b, count);
+    }
+}
+
+static int latency_hist_show(struct seq_file *m, void *v) {
+    stats_show_hist(m, m->private, offsetof(struct adxl_stats, latency_hist));
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(latency_hist);
+
+static int xfer_hist_show(struct seq_file *m, void *v) {
+    stats_show_hist(m, m->private, offsetof(struct adxl_stats, xfer_hist));
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(xfer_hist);
+
+// Racing increments may survive a reset, that is fine for statistics
+static ssize_t stats_reset_write(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos) {
+    struct my_ADXL345 *adxl = file->private_data;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(adxl->stats, cpu), 0, sizeof(struct adxl_stats));
+    WRITE_ONCE(adxl->ts_missed, 0);
+    return count;
+}
+
+static const struct file_operations stats_reset_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .write = stats_reset_write,
+    .llseek = noop_llseek,
+};
+
+static void stats_init(struct my_ADXL345 *adxl) {
+    char name[32];
+
+    snprintf(name, sizeof(name), DEVICE_NAME "-%s", dev_name(adxl->dev));
+    adxl->debugfs = debugfs_create_dir(name, NULL); // Errors are ignored, as debugfs expects
+    debugfs_create_file("stats", 0444, adxl->debugfs, adxl, &stats_fops);
+    debugfs_create_file("latency_hist", 0444, adxl->debugfs, adxl, &latency_hist_fops);
+    debugfs_create_file("xfer_hist", 0444, adxl->debugfs, adxl, &xfer_hist_fops);
+    debugfs_create_file("reset", 0200, adxl->debugfs, adxl, &stats_reset_fops);
+}
+
+static void stats_cleanup(struct my_ADXL345 *adxl) {
+    debugfs_remove_recursive(adxl->debugfs);
+    adxl->debugfs = NULL;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef STREAM_H
+#define STREAM_H
+#include "ADXL345_spi.h"
+
+// Record streams (/dev/adxl345_events, _samples, _raw): fixed size records in a kfifo.
+// The interrupt completion is the only producer, readers are serialised by read_lock.
+
+// Queue one record (completion context)
+static void stream_push(struct adxl_stream *st, const void *rec) {
+    if (kfifo_avail(&st->fifo) < st->rec_size) {
+        st->dropped++; // Reader too slow, keep the older records
+        adxl_stat_inc(st->adxl, ring_overruns);
+        return;
+    }
+    kfifo_in(&st->fifo, rec, st->rec_size);
+    wake_up_interruptible(&st->wq);
+}
+
+// Queue an event (completion context)
+static void push_event(struct my_ADXL345 *adxl, u32 type, u8 int_source, u64 ts) {
+    struct adxl345_event ev = {
+        .timestamp_ns = ts,
+        .type = type,
+        .int_source = int_source,
+    };
+
+    stream_push(&adxl->events, &ev);
+}
+
+// Stream char device file operations
+static int adxl345_stream_open(struct inode *inode, struct file *file) {
+    struct adxl_stream *st = container_of(inode->i_cdev, struct adxl_stream, cdev);
+    int ret;
+
+    ret = adxl_file_get(st->adxl); // Out of standby while anyone listens
+    if (ret)
+        return ret;
+    file->private_data = st;
+    atomic_inc(&st->users);
+    return 0;
+}
+
+static int adxl345_stream_release(struct inode *inode, struct file *file) {
+    struct adxl_stream *st = file->private_data;
+
+    atomic_dec(&st->users);
+    adxl_file_put(st->adxl);
+    return 0;
+}
+
+static ssize_t adxl345_stream_read(struct file *file, char __user *ubuf, size_t user_count, loff_t *ppos) {
+    struct adxl_stream *st = file->private_data;
+    unsigned int copied;
+    int ret;
+
+    if (user_count < st->rec_size)
+        return -EINVAL;
+
+    if (mutex_lock_interruptible(&st->read_lock))
+        return -ERESTARTSYS;
+
+    // The fifo is freed under read_lock once the device is dead
+    while (!READ_ONCE(st->adxl->dead) && kfifo_is_empty(&st->fifo)) {
+        mutex_unlock(&st->read_lock);
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(st->wq, READ_ONCE(st->adxl->dead) ||
+                                               !kfifo_is_empty(&st->fifo));
+        if (ret)
+            return ret;
+        if (mutex_lock_interruptible(&st->read_lock))
+            return -ERESTARTSYS;
+    }
+    if (READ_ONCE(st->adxl->dead)) {
+        mutex_unlock(&st->read_lock);
+        return -ENODEV;
+    }
+
+    // Whole records only, the producer always queues whole records
+    user_count -= user_count % st->rec_size;
+    ret = kfifo_to_user(&st->fifo, ubuf, user_count, &copied);
+    mutex_unlock(&st->read_lock);
+
+    return ret ? ret : copied;
+}
+
+static __poll_t adxl345_stream_poll(struct file *file, poll_table *wait) {
+    struct adxl_stream *st = file->private_data;
+
+    poll_wait(file, &st->wq, wait);
+    if (READ_ONCE(st->adxl->dead))
+        return EPOLLHUP | EPOLLERR;
+    if (!kfifo_is_empty(&st->fifo))
+        return EPOLLIN | EPOLLRDNORM;
+    return 0;
+}
+
+static const struct file_operations adxl345_stream_fops = {
+    .owner = THIS_MODULE,
+    .open = adxl345_stream_open,
+    .release = adxl345_stream_release,
+    .read = adxl345_stream_read,
+    .poll = adxl345_stream_poll,
+    .llseek = noop_llseek,
+};
+
+// Register a stream on minor "minor", class created by interface_init()
+static int stream_init(struct my_ADXL345 *adxl, struct adxl_stream *st, int minor,
+                       const char *name, unsigned int rec_size, unsigned int nr_recs)
+{
+    struct device *dev;
+    int ret;
+
+    st->adxl = adxl;
+    st->rec_size = rec_size;
+    st->devt = MKDEV(MAJOR(adxl->dev_num), MINOR(adxl->dev_num) + minor);
+    init_waitqueue_head(&st->wq);
+    mutex_init(&st->read_lock);
+    atomic_set(&st->users, 0);
+
+    ret = kfifo_alloc(&st->fifo, rec_size * nr_recs, GFP_KERNEL); // Rounded to a power of 2
+    if (ret)
+        return ret;
+
+    cdev_init(&st->cdev, &adxl345_stream_fops);
+    cdev_set_parent(&st->cdev, &adxl->kobj);
+    ret = cdev_add(&st->cdev, st->devt, 1);
+    if (ret < 0)
+        goto err_fifo;
+
+    dev = device_create(adxl->dev_class, adxl->dev, st->devt, adxl, name);
+    if (IS_ERR(dev)) {
+        ret = PTR_ERR(dev);
+        goto err_cdev;
+    }
+    return 0;
+
+err_cdev:
+    cdev_del(&st->cdev);
+err_fifo:
+    kfifo_free(&st->fifo);
+    return ret;
+}
+
+static void stream_cleanup(struct my_ADXL345 *adxl, struct adxl_stream *st)
+{
+    device_destroy(adxl->dev_class, st->devt);
+    cdev_del(&st->cdev);
+    wake_up_interruptible(&st->wq); // Readers see dead and leave
+    mutex_lock(&st->read_lock);
+    kfifo_free(&st->fifo);
+    mutex_unlock(&st->read_lock);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../adxl345_uapi.h"
+
+#define CAPTURE_PATH "/sys/bus/spi/devices/spi0.0/capture_data"
+
+// Dump a frozen capture window as CSV: time relative to the trigger (us), x, y, z
+int main(int argc, char **argv){
+	const char *path = argc > 1 ? argv[1] : CAPTURE_PATH;
+	struct adxl345_capture_header hdr;
+	struct adxl345_sample s;
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perror("Failed to open capture_data");
+		return -1;
+	}
+	if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) || hdr.magic != ADXL345_CAPTURE_MAGIC) {
+		fprintf(stderr, "No capture ready (arm with: echo 1 > capture)\n");
+		close(fd);
+		return -1;
+	}
+
+	printf("# trigger %u, %u samples (%u before trigger), ODR %u.%03u Hz\n",
+	       hdr.trigger, hdr.nr_samples, hdr.pre_samples, hdr.odr_mhz / 1000, hdr.odr_mhz % 1000);
+	printf("t_us,x,y,z\n");
+	while (read(fd, &s, sizeof(s)) == sizeof(s))
+		printf("%lld,%d,%d,%d\n", ((long long)s.timestamp_ns - (long long)hdr.trigger_ns) / 1000,
+		       s.x, s.y, s.z);
+
+	close(fd);
+	return 0;
+}
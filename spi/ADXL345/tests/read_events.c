@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include "../adxl345_uapi.h"
+
+#define EVENT_PATH "/dev/" EVENT_DEVICE_NAME
+
+static const char *event_name(__u32 type){
+	switch (type) {
+	case ADXL345_EV_SINGLE_TAP: return "SINGLE_TAP";
+	case ADXL345_EV_DOUBLE_TAP: return "DOUBLE_TAP";
+	case ADXL345_EV_ACTIVITY: return "ACTIVITY";
+	case ADXL345_EV_INACTIVITY: return "INACTIVITY";
+	case ADXL345_EV_FREE_FALL: return "FREE_FALL";
+	default: return "UNKNOWN";
+	}
+}
+
+int main(){
+	struct adxl345_event ev[16];
+	struct pollfd pfd;
+
+	pfd.fd = open(EVENT_PATH, O_RDONLY | O_NONBLOCK);
+	if (pfd.fd == -1) {
+		perror("Failed to open adxl345 event device");
+		return -1;
+	}
+	pfd.events = POLLIN;
+
+	while (1) {
+		if (poll(&pfd, 1, -1) < 0) {
+			perror("poll failed");
+			break;
+		}
+		ssize_t bytes_read = read(pfd.fd, ev, sizeof(ev));
+		if (bytes_read < 0)
+			continue;
+		for (int i = 0; i < bytes_read / (ssize_t)sizeof(ev[0]); i++)
+			printf("%llu.%09llu %s (INT_SOURCE 0x%02x)\n",
+			       (unsigned long long)(ev[i].timestamp_ns / 1000000000ULL),
+			       (unsigned long long)(ev[i].timestamp_ns % 1000000000ULL),
+			       event_name(ev[i].type), ev[i].int_source);
+	}
+	close(pfd.fd);
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+// Buffered capture through the IIO interface (same as iio_readdev -b 64 adxl345).
+// Usage: read_iio [iio:deviceN] [watermark]. A watermark > 1 runs the hardware FIFO.
+#define IIO_SYSFS "/sys/bus/iio/devices/"
+
+struct scan {
+	int16_t x, y, z;
+	int16_t pad;
+	int64_t timestamp_ns;
+};
+
+static int write_attr(const char *dev, const char *attr, const char *val){
+	char path[256];
+	int fd, ret;
+
+	snprintf(path, sizeof(path), IIO_SYSFS "%s/%s", dev, attr);
+	fd = open(path, O_WRONLY);
+	if (fd == -1) {
+		perror(path);
+		return -1;
+	}
+	ret = write(fd, val, strlen(val)) < 0 ? -1 : 0;
+	if (ret)
+		perror(path);
+	close(fd);
+	return ret;
+}
+
+int main(int argc, char **argv){
+	const char *dev = argc > 1 ? argv[1] : "iio:device0";
+	const char *wm = argc > 2 ? argv[2] : "16";
+	struct scan s[64];
+	char path[64];
+	int reads = 0;
+
+	if (write_attr(dev, "scan_elements/in_accel_x_en", "1") ||
+	    write_attr(dev, "scan_elements/in_accel_y_en", "1") ||
+	    write_attr(dev, "scan_elements/in_accel_z_en", "1") ||
+	    write_attr(dev, "scan_elements/in_timestamp_en", "1") ||
+	    write_attr(dev, "buffer/length", "256") ||
+	    write_attr(dev, "buffer/watermark", wm) ||
+	    write_attr(dev, "buffer/enable", "1"))
+		return -1;
+
+	snprintf(path, sizeof(path), "/dev/%s", dev);
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perror("Failed to open IIO device");
+		write_attr(dev, "buffer/enable", "0");
+		return -1;
+	}
+	while (reads < 100) {
+		ssize_t bytes_read = read(fd, s, sizeof(s));
+		if (bytes_read == -1) {
+			perror("Failed to read from IIO device");
+			break;
+		}
+		for (int i = 0; i < bytes_read / (ssize_t)sizeof(s[0]); i++)
+			printf("%lld X: %d Y: %d Z: %d\n", (long long)s[i].timestamp_ns,
+			       s[i].x, s[i].y, s[i].z);
+		reads++;
+	}
+	close(fd);
+	write_attr(dev, "buffer/enable", "0");
+	return 0;
+}
@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../adxl345_uapi.h"
+
+#define SAMPLE_PATH "/dev/" SAMPLE_DEVICE_NAME
+
+// Print samples from /dev/adxl345_samples (or /dev/adxl345_raw given as argument)
+int main(int argc, char **argv){
+	const char *path = argc > 1 ? argv[1] : SAMPLE_PATH;
+	struct adxl345_sample s[64];
+	int reads = 0;
+
+	int dev = open(path, O_RDONLY);
+	if (dev == -1) {
+		perror("Failed to open adxl345 sample device");
+		return -1;
+	}
+	while (reads < 100) {
+		ssize_t bytes_read = read(dev, s, sizeof(s));
+		if (bytes_read == -1) {
+			perror("Failed to read from adxl345 sample device");
+			close(dev);
+			return -1;
+		}
+		// Blocking read: one wakeup returns every record queued since the last one
+		for (int i = 0; i < bytes_read / (ssize_t)sizeof(s[0]); i++)
+			printf("%llu X: %d Y: %d Z: %d\n", (unsigned long long)s[i].timestamp_ns,
+			       s[i].x, s[i].y, s[i].z);
+		reads++;
+	}
+	close(dev);
+	return 0;
+}
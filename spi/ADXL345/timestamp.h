@@ -0,0 +1,103 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+#include "ADXL345_spi.h"
+
+// Per-sample timestamps. The hard IRQ stamps each INT1 edge; the newest sample of a batch
+// gets that stamp and earlier samples are spaced back by the estimated sample period.
+// The period starts at the nominal ODR and tracks the sensor's real clock: samples between
+// edges are counted (rounding each gap to whole periods also detects missed samples) and
+// the period is measured over windows of at least TS_WINDOW_NS to average out IRQ latency.
+
+#define TS_Q 10           // Period fixed point: ns << TS_Q
+#define TS_WINDOW_NS NSEC_PER_SEC
+#define TS_EWMA_SHIFT 2   // Period filter weight 1/4 per window
+#define TS_ACCEPT_SHIFT 3 // Ignore period measurements off by more than 1/8
+
+// Restart the estimator (ODR change, wake from idle). Any context.
+static void ts_reset(struct my_ADXL345 *adxl) {
+    WRITE_ONCE(adxl->ts_reset, true);
+}
+
+// Assign timestamps to a batch of n samples read by the current burst (completion
+// context). Returns the stamp of the oldest sample, use ts_sample() for the others.
+static u64 ts_batch(struct my_ADXL345 *adxl, unsigned int n, u64 irq_ts, bool fresh) {
+    u64 period, last, first, gap, k, counted, measured;
+    unsigned long flags;
+
+    spin_lock_irqsave(&adxl->data_lock, flags);
+    if (READ_ONCE(adxl->ts_reset) || !adxl->ts_nominal_q) {
+        WRITE_ONCE(adxl->ts_reset, false);
+        adxl->ts_nominal_q = div_u64((u64)NSEC_PER_SEC * 1000 << TS_Q,
+                                     adxl345_odr_mhz[adxl->bw_rate & BW_RATE_RATE_MASK]);
+        adxl->ts_period_q = adxl->ts_nominal_q;
+        adxl->ts_anchor_ns = 0;
+        adxl->ts_edge_ns = 0;
+        adxl->ts_last_ns = 0;
+        adxl->ts_pending = 0;
+        adxl->ts_win_samples = 0;
+    }
+    period = adxl->ts_period_q;
+
+    if (fresh && adxl->ts_edge_ns) {
+        // Samples the sensor produced since the previous edge vs samples we received
+        gap = irq_ts - adxl->ts_edge_ns;
+        counted = adxl->ts_pending + n;
+        k = div64_u64((gap << TS_Q) + period / 2, period);
+        if (k < counted)
+            k = counted;
+        adxl->ts_missed += k - counted;
+        adxl->ts_win_samples += k;
+
+        gap = irq_ts - adxl->ts_anchor_ns;
+        if (gap >= TS_WINDOW_NS) {
+            measured = div64_u64(gap << TS_Q, adxl->ts_win_samples);
+            if (measured + (period >> TS_ACCEPT_SHIFT) > period &&
+                measured < period + (period >> TS_ACCEPT_SHIFT)) {
+                period = period - (period >> TS_EWMA_SHIFT) + (measured >> TS_EWMA_SHIFT);
+                adxl->ts_period_q = period;
+            }
+            adxl->ts_anchor_ns = irq_ts;
+            adxl->ts_win_samples = 0;
+        }
+    } else if (fresh) {
+        adxl->ts_anchor_ns = irq_ts;
+    }
+
+    if (fresh) {
+        adxl->ts_edge_ns = irq_ts;
+        adxl->ts_pending = 0;
+        last = irq_ts;
+    } else {
+        // No new edge (INT1 still high after the last burst): extrapolate
+        adxl->ts_pending += n;
+        last = adxl->ts_last_ns ? adxl->ts_last_ns + ((n * period) >> TS_Q) : irq_ts;
+    }
+
+    first = last - (((u64)(n - 1) * period) >> TS_Q);
+    if (adxl->ts_last_ns && first <= adxl->ts_last_ns) // Keep stamps strictly increasing
+        first = adxl->ts_last_ns + (period >> TS_Q);
+    adxl->ts_last_ns = first + (((u64)(n - 1) * period) >> TS_Q);
+    spin_unlock_irqrestore(&adxl->data_lock, flags);
+
+    return first;
+}
+
+// Stamp of sample i of the batch whose oldest sample is stamped first
+static u64 ts_sample(struct my_ADXL345 *adxl, u64 first, unsigned int i) {
+    return first + (((u64)i * READ_ONCE(adxl->ts_period_q)) >> TS_Q);
+}
+
+// Estimated sensor clock error vs the nominal ODR, in ppm
+static s64 ts_drift_ppm(struct my_ADXL345 *adxl) {
+    unsigned long flags;
+    s64 ppm = 0;
+
+    spin_lock_irqsave(&adxl->data_lock, flags);
+    if (adxl->ts_nominal_q)
+        ppm = div64_s64(((s64)adxl->ts_period_q - (s64)adxl->ts_nominal_q) * 1000000,
+                        (s64)adxl->ts_nominal_q);
+    spin_unlock_irqrestore(&adxl->data_lock, flags);
+    return ppm;
+}
+
+#endif
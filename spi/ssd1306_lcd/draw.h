@@ -0,0 +1,159 @@
+#ifndef DRAW_H
+#define DRAW_H
+#include "ssd1306.h"
+#include "flush.h"
+#include "ssd1306_uapi.h"
+
+// Batched drawing (SSD1306_IOC_DRAW, SSD1306_IOC_DRAW_LIST on /dev/fbN): fills, lines and
+// 1 bpp blits are clipped and drawn here a byte at a time where possible, and each primitive
+// adds only its clipped rectangle to the dirty regions. A whole list runs under lcd->lock, so
+// no flush sees it half drawn, and is flushed once afterwards.
+
+#define DRAW_CHUNK 16 // Commands copied from userspace at a time
+
+static void draw_bits(u8 *dst, u8 mask, u8 color){
+	if (color == SSD1306_COLOR_CLEAR)
+		*dst &= ~mask;
+	else if (color == SSD1306_COLOR_SET)
+		*dst |= mask;
+	else
+		*dst ^= mask;
+}
+
+// Pixels x0..x1 of one framebuffer row: partial bytes at the ends, whole bytes in between
+static void draw_span(u8 *row, int x0, int x1, u8 color){
+	int b0 = x0 / 8, b1 = x1 / 8, b;
+	u8 m0 = 0xFF >> (x0 % 8);
+	u8 m1 = 0xFF << (7 - x1 % 8);
+
+	if (b0 == b1) {
+		draw_bits(&row[b0], m0 & m1, color);
+		return;
+	}
+	draw_bits(&row[b0], m0, color);
+	for (b = b0 + 1; b < b1; b++)
+		draw_bits(&row[b], 0xFF, color);
+	draw_bits(&row[b1], m1, color);
+}
+
+// Blit the part of the image that lands on x0..x1, y0..y1 (already clipped)
+static int draw_blit(struct my_lcd *lcd, u8 *frame, const struct ssd1306_draw_cmd *cmd,
+		     int x0, int y0, int x1, int y1){
+	const u8 __user *src = u64_to_user_ptr(cmd->data);
+	const int line = lcd->width / 8;
+	const int stride = (cmd->w + 7) / 8;
+	u8 buf[SSD1306_MAX_WIDTH / 8 + 1];
+	int sx = x0 - cmd->x, sy = y0 - cmd->y;
+	int r, i, s;
+	u8 *dst, m;
+
+	for (r = 0; r <= y1 - y0; r++) {
+		// Only the source bytes that are visible
+		if (copy_from_user(buf, src + (sy + r) * stride + sx / 8, (sx % 8 + x1 - x0) / 8 + 1))
+			return -EFAULT;
+		for (i = 0; i <= x1 - x0; i++) {
+			s = buf[(sx % 8 + i) / 8] & (0x80 >> ((sx + i) % 8));
+			dst = frame + (y0 + r) * line + (x0 + i) / 8;
+			m = 0x80 >> ((x0 + i) % 8);
+			if (cmd->color == SSD1306_COLOR_INVERT)
+				*dst ^= s ? m : 0;
+			else if (s)
+				*dst |= m;
+			else
+				*dst &= ~m;
+		}
+	}
+	return 0;
+}
+
+// One primitive. Caller holds lcd->lock.
+static int draw_cmd(struct my_lcd *lcd, u8 *frame, const struct ssd1306_draw_cmd *cmd, bool front){
+	const int line = lcd->width / 8;
+	int w = cmd->w, h = cmd->h;
+	int x0, y0, x1, y1, r, ret = 0;
+
+	switch (cmd->op) {
+	case SSD1306_OP_FILL:
+	case SSD1306_OP_BLIT:
+		break;
+	case SSD1306_OP_HLINE:
+		h = 1;
+		break;
+	case SSD1306_OP_VLINE:
+		w = 1;
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (cmd->color > SSD1306_COLOR_INVERT)
+		return -EINVAL;
+
+	x0 = max_t(int, cmd->x, 0);
+	y0 = max_t(int, cmd->y, 0);
+	x1 = min(cmd->x + w, lcd->width) - 1;
+	y1 = min(cmd->y + h, lcd->height) - 1;
+	if (x0 > x1 || y0 > y1)
+		return 0; // Off screen
+
+	if (front)
+		lcd_dirty_add(lcd, x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+	if (cmd->op == SSD1306_OP_BLIT)
+		ret = draw_blit(lcd, frame, cmd, x0, y0, x1, y1);
+	else
+		for (r = y0; r <= y1; r++)
+			draw_span(frame + r * line, x0, x1, cmd->color);
+	return ret;
+}
+
+// Run count commands from userspace into the front or the hidden frame
+static int draw_cmds(struct my_lcd *lcd, const struct ssd1306_draw_cmd __user *ucmds, u32 count, u32 flags){
+	struct ssd1306_draw_cmd cmds[DRAW_CHUNK];
+	const bool front = !(flags & SSD1306_DRAW_BACK);
+	u32 done = 0, n, i;
+	u8 *frame;
+	int ret = 0;
+
+	if (flags & ~SSD1306_DRAW_BACK || count > SSD1306_DRAW_LIST_MAX)
+		return -EINVAL;
+
+	mutex_lock(&lcd->lock);
+	if (front) {
+		lcd_set_text_mode(lcd, false);
+		frame = lcd->framebuffer + lcd->front_y * (lcd->width / 8);
+	} else {
+		frame = lcd->framebuffer + (lcd->front_y + lcd->height) % (lcd->height * SSD1306_FRAMES) *
+			(lcd->width / 8);
+	}
+	while (done < count && !ret) {
+		n = min_t(u32, count - done, DRAW_CHUNK);
+		if (copy_from_user(cmds, ucmds + done, n * sizeof(cmds[0]))) {
+			ret = -EFAULT;
+			break;
+		}
+		for (i = 0; i < n && !ret; i++)
+			ret = draw_cmd(lcd, frame, &cmds[i], front);
+		done += n;
+	}
+	mutex_unlock(&lcd->lock);
+
+	if (front && done)
+		lcd_queue_flush(lcd); // Whatever got drawn
+	return ret;
+}
+
+static int draw_ioctl(struct my_lcd *lcd, unsigned int cmd, void __user *argp){
+	struct ssd1306_draw_list list;
+
+	switch (cmd) {
+	case SSD1306_IOC_DRAW:
+		return draw_cmds(lcd, argp, 1, 0);
+	case SSD1306_IOC_DRAW_LIST:
+		if (copy_from_user(&list, argp, sizeof(list)))
+			return -EFAULT;
+		return draw_cmds(lcd, u64_to_user_ptr(list.cmds), list.count, list.flags);
+	default:
+		return -ENOTTY;
+	}
+}
+
+#endif
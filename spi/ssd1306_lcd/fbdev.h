@@ -0,0 +1,263 @@
+#ifndef FBDEV_H
+#define FBDEV_H
+#include "ssd1306.h"
+#include "flush.h"
+#include "flip.h"
+#include "text.h"
+#include "draw.h"
+#include "scroll.h"
+
+// fbdev front end: /dev/fbN in system memory (1 bpp, row-major, 1 = pixel lit).
+// Every drawing op marks what it touched dirty, flush.h sends only that.
+// mmap goes through deferred I/O: the first write to a page after a flush faults, the page
+// is collected and the rows it covers are flushed one frame period later. The whole 128x64
+// buffer fits in one memory page, the shadow compare in lcd_flush() finds what changed.
+// Drawing into the hidden frame of the double buffer (flip.h) is not flushed, only flipped.
+// write(), mmap and flips take the panel back from the text console (text.h).
+// Unbind only unregisters: fb_info and lcd go with the last close of /dev/fbN.
+
+// Drawing ops work in framebuffer rows, the dirty regions in rows of the front frame
+static void ssd1306_fb_mark_dirty(struct fb_info *info, int x, int y, int w, int h){
+	struct my_lcd *lcd = info->par;
+
+	lcd_mark_dirty(lcd, x, y - READ_ONCE(lcd->front_y), w, h);
+}
+
+static ssize_t ssd1306_fb_write(struct fb_info *info, const char __user *buf, size_t count, loff_t *ppos){
+	struct my_lcd *lcd = info->par;
+	loff_t start = *ppos;
+	ssize_t ret;
+	int y0, y1;
+
+	ret = fb_sys_write(info, buf, count, ppos);
+	if (ret > 0) {
+		mutex_lock(&lcd->lock);
+		lcd_set_text_mode(lcd, false);
+		mutex_unlock(&lcd->lock);
+		y0 = start / info->fix.line_length;
+		y1 = (start + ret - 1) / info->fix.line_length;
+		ssd1306_fb_mark_dirty(info, 0, y0, lcd->width, y1 - y0 + 1);
+	}
+	return ret;
+}
+
+static void ssd1306_fb_fillrect(struct fb_info *info, const struct fb_fillrect *rect){
+	sys_fillrect(info, rect);
+	ssd1306_fb_mark_dirty(info, rect->dx, rect->dy, rect->width, rect->height);
+}
+
+static void ssd1306_fb_copyarea(struct fb_info *info, const struct fb_copyarea *area){
+	sys_copyarea(info, area);
+	ssd1306_fb_mark_dirty(info, area->dx, area->dy, area->width, area->height);
+}
+
+static void ssd1306_fb_imageblit(struct fb_info *info, const struct fb_image *image){
+	sys_imageblit(info, image);
+	ssd1306_fb_mark_dirty(info, image->dx, image->dy, image->width, image->height);
+}
+
+static int ssd1306_fb_blank(int blank_mode, struct fb_info *info){
+	struct my_lcd *lcd = info->par;
+	u8 cmd = blank_mode == FB_BLANK_UNBLANK ? DISPLAY_ON : DISPLAY_OFF;
+	int ret;
+
+	mutex_lock(&lcd->lock);
+	ret = lcd_write_cmds(lcd, &cmd, 1);
+	mutex_unlock(&lcd->lock);
+	return ret;
+}
+
+// Flip: yoffset selects the front frame
+static int ssd1306_fb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info){
+	struct my_lcd *lcd = info->par;
+
+	if (var->xoffset || var->yoffset % lcd->height)
+		return -EINVAL;
+	return lcd_flip(lcd, var->yoffset);
+}
+
+static int ssd1306_fb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long arg){
+	u32 crtc;
+
+	switch (cmd) {
+	case FBIO_WAITFORVSYNC:
+		if (get_user(crtc, (u32 __user *)arg))
+			return -EFAULT;
+		if (crtc)
+			return -ENODEV;
+		return lcd_flip_wait(info->par);
+	case SSD1306_IOC_DRAW:
+	case SSD1306_IOC_DRAW_LIST:
+		return draw_ioctl(info->par, cmd, (void __user *)arg);
+	case SSD1306_IOC_SCROLL_START:
+	case SSD1306_IOC_SCROLL_STOP:
+	case SSD1306_IOC_SET_START_LINE:
+		return scroll_ioctl(info->par, cmd, (void __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+#ifdef CONFIG_COMPAT
+// The uapi structs have the same layout for 32-bit userspace, only the pointer needs fixing
+static int ssd1306_fb_compat_ioctl(struct fb_info *info, unsigned int cmd, unsigned long arg){
+	return ssd1306_fb_ioctl(info, cmd, (unsigned long)compat_ptr(arg));
+}
+#endif
+
+// Deferred I/O callback (defio work): pages written through mmap since the last call
+static void ssd1306_fb_deferred_io(struct fb_info *info, struct list_head *pagereflist){
+	struct my_lcd *lcd = info->par;
+	struct fb_deferred_io_pageref *pageref;
+	unsigned long start, end;
+
+	list_for_each_entry(pageref, pagereflist, list) {
+		start = pageref->offset;
+		end = min_t(unsigned long, start + PAGE_SIZE, info->fix.smem_len);
+		if (start >= end)
+			continue;
+		lcd_dirty_add(lcd, 0, start / info->fix.line_length - READ_ONCE(lcd->front_y), lcd->width,
+			      (end - 1) / info->fix.line_length - start / info->fix.line_length + 1);
+	}
+
+	mutex_lock(&lcd->lock);
+	lcd_set_text_mode(lcd, false);
+	lcd_flush(lcd);
+	mutex_unlock(&lcd->lock);
+}
+
+// Last reference to the fb_info, after unregister_framebuffer()
+static void ssd1306_fb_destroy(struct fb_info *info){
+	struct my_lcd *lcd = info->par;
+
+	fb_deferred_io_cleanup(info);
+	framebuffer_release(info);
+	lcd_put(lcd);
+}
+
+static const struct fb_ops ssd1306_fb_ops = {
+	.owner = THIS_MODULE,
+	.fb_read = fb_sys_read,
+	.fb_write = ssd1306_fb_write,
+	.fb_fillrect = ssd1306_fb_fillrect,
+	.fb_copyarea = ssd1306_fb_copyarea,
+	.fb_imageblit = ssd1306_fb_imageblit,
+	.fb_blank = ssd1306_fb_blank,
+	.fb_pan_display = ssd1306_fb_pan_display,
+	.fb_ioctl = ssd1306_fb_ioctl,
+#ifdef CONFIG_COMPAT
+	.fb_compat_ioctl = ssd1306_fb_compat_ioctl,
+#endif
+	.fb_mmap = fb_deferred_io_mmap,
+	.fb_destroy = ssd1306_fb_destroy,
+};
+
+static void fbdev_cleanup(struct my_lcd *lcd){
+	if (!lcd->info)
+		return;
+	unregister_framebuffer(lcd->info); // Open files keep it, ssd1306_fb_destroy() frees it
+	lcd->info = NULL;
+}
+
+// sysfs - Flush rate limit in frames per second, for mmap and drawing ops alike
+static ssize_t max_fps_show(struct device *dev, struct device_attribute *attr, char *buf){
+	struct my_lcd *lcd = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(lcd->max_fps));
+}
+
+static ssize_t max_fps_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count){
+	struct my_lcd *lcd = dev_get_drvdata(dev);
+	unsigned int fps;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &fps);
+	if (ret)
+		return ret;
+	if (fps < 1 || fps > SSD1306_MAX_FPS)
+		return -EINVAL;
+
+	WRITE_ONCE(lcd->max_fps, fps);
+	lcd->defio.delay = lcd_frame_delay(lcd); // Read by defio on the next page fault
+	return count;
+}
+static DEVICE_ATTR_RW(max_fps);
+
+// sysfs - Completed flips, for pacing and frame rate measurements
+static ssize_t frames_show(struct device *dev, struct device_attribute *attr, char *buf){
+	struct my_lcd *lcd = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(lcd->frames));
+}
+static DEVICE_ATTR_RO(frames);
+
+static struct attribute *ssd1306_attrs[] = {
+	&dev_attr_max_fps.attr,
+	&dev_attr_frames.attr,
+	NULL,
+};
+
+static const struct attribute_group ssd1306_attr_group = {
+	.attrs = ssd1306_attrs,
+};
+
+static int fbdev_init(struct my_lcd *lcd){
+	struct fb_info *info;
+	int ret;
+
+	info = framebuffer_alloc(0, &lcd->spi->dev);
+	if (!info)
+		return -ENOMEM;
+
+	info->par = lcd;
+	info->fbops = &ssd1306_fb_ops;
+	info->flags = FBINFO_VIRTFB;
+	info->screen_buffer = lcd->framebuffer;
+
+	strscpy(info->fix.id, "ssd1306", sizeof(info->fix.id));
+	info->fix.type = FB_TYPE_PACKED_PIXELS;
+	info->fix.visual = FB_VISUAL_MONO10; // 1 = lit pixel
+	info->fix.line_length = lcd->width / 8;
+	info->fix.smem_len = lcd->width * lcd->height / 8 * SSD1306_FRAMES;
+	info->fix.ypanstep = lcd->height;
+	info->fix.accel = FB_ACCEL_NONE;
+
+	info->var.xres = lcd->width;
+	info->var.yres = lcd->height;
+	info->var.xres_virtual = lcd->width;
+	info->var.yres_virtual = lcd->height * SSD1306_FRAMES;
+	info->var.bits_per_pixel = 1;
+	info->var.red.length = 1;
+	info->var.green.length = 1;
+	info->var.blue.length = 1;
+	info->var.activate = FB_ACTIVATE_NOW;
+
+	lcd->defio.delay = lcd_frame_delay(lcd);
+	lcd->defio.deferred_io = ssd1306_fb_deferred_io;
+	info->fbdefio = &lcd->defio;
+	ret = fb_deferred_io_init(info);
+	if (ret) {
+		framebuffer_release(info);
+		return ret;
+	}
+
+	ret = register_framebuffer(info);
+	if (ret) {
+		dev_err(&lcd->spi->dev, "Failed to register framebuffer: %d\n", ret);
+		fb_deferred_io_cleanup(info);
+		framebuffer_release(info);
+		return ret;
+	}
+	kref_get(&lcd->ref); // Dropped in ssd1306_fb_destroy()
+	lcd->info = info;
+
+	ret = sysfs_create_group(&lcd->spi->dev.kobj, &ssd1306_attr_group);
+	if (ret) {
+		fbdev_cleanup(lcd);
+		return ret;
+	}
+	dev_info(&lcd->spi->dev, "fb%d: %dx%d SSD1306\n", info->node, lcd->width, lcd->height);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef FLIP_H
+#define FLIP_H
+#include "ssd1306.h"
+#include "flush.h"
+
+// Double buffering: the framebuffer holds SSD1306_FRAMES frames stacked vertically. Userspace
+// draws into the hidden one and flips with FBIOPAN_DISPLAY (yoffset 0 or height). The flip
+// diffs the new front frame against the shadow, sends the address window synchronously (a few
+// bytes) and the pixel data with spi_async, so the caller can start on the next frame while
+// it is on the wire. FBIO_WAITFORVSYNC blocks until the last flip has reached the panel;
+// wait before drawing into the frame that was just hidden to render without tearing.
+
+static void lcd_flip_complete(void *context);
+
+// Queue the next xfer_max bytes of the frame (D/C is already high)
+static int lcd_flip_submit(struct my_lcd *lcd){
+	size_t n = min(lcd->flip_len - lcd->flip_off, lcd->xfer_max);
+
+	lcd_stats_xfer(lcd, n);
+	lcd->flip_xfer.tx_buf = lcd->tx_buf + lcd->flip_off;
+	lcd->flip_xfer.len = n;
+	spi_message_init_with_transfers(&lcd->flip_msg, &lcd->flip_xfer, 1);
+	lcd->flip_msg.complete = lcd_flip_complete;
+	lcd->flip_msg.context = lcd;
+	return spi_async(lcd->spi, &lcd->flip_msg);
+}
+
+// One message of the frame is out: queue the next, other panels' messages can go in between
+static void lcd_flip_complete(void *context){
+	struct my_lcd *lcd = context;
+	int ret = lcd->flip_msg.status;
+
+	if (!ret) {
+		lcd->flip_off += lcd->flip_xfer.len;
+		if (lcd->flip_off < lcd->flip_len) {
+			ret = lcd_flip_submit(lcd);
+			if (!ret)
+				return;
+		}
+	}
+
+	lcd_stats_update(lcd, lcd->flip_start_ns);
+	if (ret) {
+		dev_err_ratelimited(&lcd->spi->dev, "Frame write failed: %d\n", ret);
+		WRITE_ONCE(lcd->shadow_valid, false); // Resend everything next time
+	}
+	lcd->frames++;
+	smp_store_release(&lcd->flip_busy, false);
+	wake_up_all(&lcd->flip_wq);
+}
+
+// Make rows y..y+height-1 of the framebuffer the front frame and start sending it
+static int lcd_flip(struct my_lcd *lcd, int y){
+	struct lcd_window w = { .x0 = lcd->width, .x1 = -1, .p0 = -1, .p1 = -1 };
+	unsigned long flags;
+	size_t len;
+	int p, x;
+	u8 col;
+	int ret;
+
+	mutex_lock(&lcd->lock);
+	if (lcd->scrolling) {
+		mutex_unlock(&lcd->lock);
+		return -EBUSY; // Panel RAM is off limits until SSD1306_IOC_SCROLL_STOP
+	}
+	lcd_wait_idle(lcd); // Previous frame still going out, tx_buf is busy
+	lcd->front_y = y;
+	lcd->text_mode = false; // Flipping hands the panel back to the framebuffer
+
+	// The whole frame gets compared below, pending regions of the old front are moot
+	spin_lock_irqsave(&lcd->dirty_lock, flags);
+	for (p = 0; p < lcd->pages; p++) {
+		lcd->dirty[p].x0 = U8_MAX;
+		lcd->dirty[p].x1 = 0;
+	}
+	spin_unlock_irqrestore(&lcd->dirty_lock, flags);
+
+	for (p = 0; p < lcd->pages; p++) {
+		for (x = 0; x < lcd->width; x++) {
+			col = lcd_fb_column(lcd, p, x);
+			if (lcd->shadow_valid && lcd->shadow[p * lcd->width + x] == col)
+				continue;
+			lcd->shadow[p * lcd->width + x] = col;
+			w.x0 = min(w.x0, x);
+			w.x1 = max(w.x1, x);
+			if (w.p0 < 0)
+				w.p0 = p;
+			w.p1 = p;
+		}
+	}
+	if (w.p0 < 0) {
+		// Identical frame: nothing to send, it is on the panel already
+		lcd->frames++;
+		wake_up_all(&lcd->flip_wq);
+		mutex_unlock(&lcd->lock);
+		return 0;
+	}
+
+	// One window around everything that changed: a completion cannot drive D/C for a second
+	len = lcd_gather(lcd, &w);
+	lcd->flip_start_ns = ktime_get_ns();
+	ret = lcd_write_cmds(lcd, (const u8 []){ SET_COLUMN_ADDR, w.x0, w.x1, SET_PAGE_ADDR, w.p0, w.p1 }, 6);
+	if (ret)
+		goto err;
+
+	lcd_set_dc(lcd, 1);
+	lcd->flip_off = 0;
+	lcd->flip_len = len;
+
+	lcd->shadow_valid = true; // Every differing column is in the window
+	WRITE_ONCE(lcd->flip_busy, true);
+	ret = lcd_flip_submit(lcd);
+	if (ret) {
+		WRITE_ONCE(lcd->flip_busy, false);
+		wake_up_all(&lcd->flip_wq); // FBIO_WAITFORVSYNC may already wait on this flip
+		goto err;
+	}
+	mutex_unlock(&lcd->lock);
+	return 0;
+
+err:
+	lcd->shadow_valid = false;
+	mutex_unlock(&lcd->lock);
+	return ret;
+}
+
+// Block until no flip is in flight, the vsync of a panel without one
+static int lcd_flip_wait(struct my_lcd *lcd){
+	return wait_event_interruptible(lcd->flip_wq, !smp_load_acquire(&lcd->flip_busy));
+}
+
+static void lcd_flip_init(struct my_lcd *lcd){
+	init_waitqueue_head(&lcd->flip_wq);
+	lcd->flip_busy = false;
+	lcd->front_y = 0;
+}
+
+#endif
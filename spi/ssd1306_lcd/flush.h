@@ -0,0 +1,232 @@
+#ifndef FLUSH_H
+#define FLUSH_H
+#include "ssd1306.h"
+
+// Partial updates: drawing marks the touched columns of each 8-row page dirty, the flush
+// converts only those columns to the panel's page format and sends the columns that really
+// changed (compared with the shadow of panel RAM) through a column/page address window.
+// Flushes run at most once per frame period, drawing in between is coalesced.
+// D/C is a GPIO, so it cannot change inside a message: each window costs one command and
+// one data message. Windows of neighbouring pages are merged when the extra bytes cost less
+// than the extra messages, and D/C is only driven when it changes.
+
+#define LCD_WINDOW_COST 32 // Bus time of one more window in bytes: messages, D/C toggles, commands
+
+// Add a rectangle (panel coordinates) to the dirty regions, returns false if it is empty after clipping
+static bool lcd_dirty_add(struct my_lcd *lcd, int x, int y, int w, int h){
+	unsigned long flags;
+	int x1, y1, p;
+
+	x1 = min(x + w, lcd->width) - 1;
+	y1 = min(y + h, lcd->height) - 1;
+	x = max(x, 0);
+	y = max(y, 0);
+	if (x > x1 || y > y1)
+		return false;
+
+	spin_lock_irqsave(&lcd->dirty_lock, flags);
+	for (p = y / 8; p <= y1 / 8; p++) {
+		if (lcd->dirty[p].x0 > lcd->dirty[p].x1) {
+			lcd->dirty[p].x0 = x;
+			lcd->dirty[p].x1 = x1;
+		} else {
+			lcd->dirty[p].x0 = min_t(int, lcd->dirty[p].x0, x);
+			lcd->dirty[p].x1 = max_t(int, lcd->dirty[p].x1, x1);
+		}
+	}
+	spin_unlock_irqrestore(&lcd->dirty_lock, flags);
+	return true;
+}
+
+// Flush at the end of the frame period (any context), a no-op if one is pending already
+static void lcd_queue_flush(struct my_lcd *lcd){
+	queue_delayed_work(ssd1306_wq, &lcd->flush_work, lcd_frame_delay(lcd));
+}
+
+// Mark a rectangle dirty and queue a flush (any context)
+static void lcd_mark_dirty(struct my_lcd *lcd, int x, int y, int w, int h){
+	if (lcd_dirty_add(lcd, x, y, w, h))
+		lcd_queue_flush(lcd);
+}
+
+// Column x of page p from the front frame of the row-major framebuffer
+static u8 lcd_fb_column(struct my_lcd *lcd, int p, int x){
+	const int line = lcd->width / 8;
+	const u8 *src = lcd->framebuffer + (lcd->front_y + p * 8) * line + x / 8;
+	u8 mask = 0x80 >> (x % 8);
+	u8 col = 0;
+	int r;
+
+	for (r = 0; r < 8; r++, src += line)
+		if (*src & mask)
+			col |= 1 << r;
+	return col;
+}
+
+// Column x of page p as the panel should show it
+static u8 lcd_column(struct my_lcd *lcd, int p, int x){
+	if (lcd->text_mode)
+		return lcd->text[p * lcd->width + x]; // Already in page format
+	return lcd_fb_column(lcd, p, x);
+}
+
+// Switch what the panel shows between the framebuffer and the text console. Caller holds lcd->lock.
+static void lcd_set_text_mode(struct my_lcd *lcd, bool text){
+	if (lcd->text_mode == text)
+		return;
+	lcd->text_mode = text;
+	lcd_dirty_add(lcd, 0, 0, lcd->width, lcd->height); // The shadow compare trims the resend
+}
+
+// Gather window w from the shadow into tx_buf, returns the byte count. Caller holds lcd->lock.
+static size_t lcd_gather(struct my_lcd *lcd, const struct lcd_window *w){
+	const int len = w->x1 - w->x0 + 1;
+	u8 *dst = lcd->tx_buf;
+	int p;
+
+	lcd_wait_idle(lcd); // tx_buf may still be going out with a flip
+	for (p = w->p0; p <= w->p1; p++, dst += len)
+		memcpy(dst, lcd->shadow + p * lcd->width + w->x0, len);
+	return dst - lcd->tx_buf;
+}
+
+// One window is two messages: the address commands, then all its data in one transfer.
+// Caller holds lcd->lock.
+static int lcd_send_window(struct my_lcd *lcd, const struct lcd_window *w){
+	const u8 cmds[] = {
+		SET_COLUMN_ADDR, w->x0, w->x1,
+		SET_PAGE_ADDR, w->p0, w->p1,
+	};
+	size_t len = lcd_gather(lcd, w);
+	int ret;
+
+	ret = lcd_write_cmds(lcd, cmds, sizeof(cmds));
+	if (ret)
+		return ret;
+	return lcd_write_data(lcd, lcd->tx_buf, len);
+}
+
+// Group the changed spans of the pages (first[p] < 0: unchanged) into address windows.
+// A page joins the window above it while sending the union, unchanged columns and pages
+// in between included, costs less than a window of its own (LCD_WINDOW_COST). Returns the
+// number of windows.
+static int lcd_plan(struct my_lcd *lcd, const int *first, const int *last, struct lcd_window *win){
+	struct lcd_window *w = NULL;
+	int p, n = 0, x0, x1, merged, separate;
+
+	for (p = 0; p < lcd->pages; p++) {
+		if (first[p] < 0)
+			continue;
+		if (w) {
+			x0 = min(w->x0, first[p]);
+			x1 = max(w->x1, last[p]);
+			merged = (x1 - x0 + 1) * (p - w->p0 + 1);
+			separate = (w->x1 - w->x0 + 1) * (w->p1 - w->p0 + 1) +
+				   (last[p] - first[p] + 1) + LCD_WINDOW_COST;
+			if (merged <= separate) {
+				w->x0 = x0;
+				w->x1 = x1;
+				w->p1 = p;
+				continue;
+			}
+		}
+		w = &win[n++];
+		w->x0 = first[p];
+		w->x1 = last[p];
+		w->p0 = p;
+		w->p1 = p;
+	}
+	return n;
+}
+
+// Push every dirty region to the panel. Caller holds lcd->lock.
+static int lcd_flush(struct my_lcd *lcd){
+	struct lcd_dirty dirty[SSD1306_MAX_PAGES];
+	struct lcd_window win[SSD1306_MAX_PAGES];
+	int first[SSD1306_MAX_PAGES], last[SSD1306_MAX_PAGES];
+	unsigned long flags;
+	int p, x, n, i, ret = 0;
+	u64 start;
+	u8 col;
+
+	if (lcd->dead)
+		return -ENODEV;
+	if (lcd->scrolling)
+		return 0; // No RAM writes during a hardware scroll, the regions stay dirty
+
+	spin_lock_irqsave(&lcd->dirty_lock, flags);
+	memcpy(dirty, lcd->dirty, sizeof(dirty));
+	for (p = 0; p < lcd->pages; p++) {
+		lcd->dirty[p].x0 = U8_MAX;
+		lcd->dirty[p].x1 = 0;
+	}
+	spin_unlock_irqrestore(&lcd->dirty_lock, flags);
+
+	for (p = 0; p < lcd->pages; p++) {
+		// Trim to the columns that differ from what the panel already shows
+		first[p] = -1;
+		last[p] = -1;
+		if (dirty[p].x0 > dirty[p].x1)
+			continue;
+		for (x = dirty[p].x0; x <= dirty[p].x1; x++) {
+			col = lcd_column(lcd, p, x);
+			if (lcd->shadow_valid && lcd->shadow[p * lcd->width + x] == col)
+				continue;
+			lcd->shadow[p * lcd->width + x] = col;
+			if (first[p] < 0)
+				first[p] = x;
+			last[p] = x;
+		}
+	}
+
+	n = lcd_plan(lcd, first, last, win);
+	if (!n)
+		return 0;
+
+	start = ktime_get_ns();
+	for (i = 0; i < n; i++) {
+		ret = lcd_send_window(lcd, &win[i]);
+		if (ret)
+			break;
+	}
+	if (ret) {
+		// Panel RAM is unknown from here on: resend the rest on the next flush
+		for (; i < n; i++)
+			lcd_dirty_add(lcd, win[i].x0, win[i].p0 * 8, win[i].x1 - win[i].x0 + 1,
+				      (win[i].p1 - win[i].p0 + 1) * 8);
+		lcd->shadow_valid = false;
+		return ret;
+	}
+	lcd_stats_update(lcd, start);
+	lcd->shadow_valid = true;
+	return 0;
+}
+
+static void lcd_flush_work(struct work_struct *work){
+	struct my_lcd *lcd = container_of(to_delayed_work(work), struct my_lcd, flush_work);
+
+	mutex_lock(&lcd->lock);
+	lcd_flush(lcd);
+	mutex_unlock(&lcd->lock);
+}
+
+// Start clean, then send the whole framebuffer once so the shadow matches panel RAM
+static int lcd_flush_init(struct my_lcd *lcd){
+	int p, ret;
+
+	lcd->shadow_valid = false;
+	spin_lock_init(&lcd->dirty_lock);
+	INIT_DELAYED_WORK(&lcd->flush_work, lcd_flush_work);
+	for (p = 0; p < SSD1306_MAX_PAGES; p++) {
+		lcd->dirty[p].x0 = U8_MAX;
+		lcd->dirty[p].x1 = 0;
+	}
+
+	lcd_dirty_add(lcd, 0, 0, lcd->width, lcd->height);
+	mutex_lock(&lcd->lock);
+	ret = lcd_flush(lcd);
+	mutex_unlock(&lcd->lock);
+	return ret;
+}
+
+#endif
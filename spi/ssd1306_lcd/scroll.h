@@ -0,0 +1,113 @@
+#ifndef SCROLL_H
+#define SCROLL_H
+#include "ssd1306.h"
+#include "flush.h"
+#include "ssd1306_uapi.h"
+
+// Hardware scrolling and the display start line, see ssd1306_uapi.h for the userspace view.
+
+// Scroll step interval codes (datasheet, command 0x26 byte C), indexed by code
+static const u16 scroll_frames[] = { 5, 64, 128, 256, 3, 4, 25, 2 };
+
+static int scroll_interval(u16 frames){
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(scroll_frames); i++)
+		if (scroll_frames[i] == frames)
+			return i;
+	return -EINVAL;
+}
+
+static int scroll_start(struct my_lcd *lcd, const struct ssd1306_scroll *sc){
+	u8 cmds[16];
+	int n = 0, interval, rows, ret;
+
+	interval = scroll_interval(sc->frames);
+	rows = sc->scroll_rows ? sc->scroll_rows : lcd->height - sc->fixed_rows;
+	if (interval < 0 || sc->dir > SSD1306_SCROLL_LEFT ||
+	    sc->start_page > sc->end_page || sc->end_page >= lcd->pages ||
+	    sc->fixed_rows + rows > lcd->height || (sc->vertical && sc->vertical >= rows))
+		return -EINVAL;
+
+	cmds[n++] = SCROLL_OFF; // A new setup needs the scroll stopped
+	if (sc->vertical) {
+		cmds[n++] = SET_VERT_SCROLL_AREA;
+		cmds[n++] = sc->fixed_rows;
+		cmds[n++] = rows;
+		cmds[n++] = sc->dir == SSD1306_SCROLL_RIGHT ? SCROLL_VERT_RIGHT : SCROLL_VERT_LEFT;
+	} else {
+		cmds[n++] = sc->dir == SSD1306_SCROLL_RIGHT ? SCROLL_RIGHT : SCROLL_LEFT;
+	}
+	cmds[n++] = 0x00; // Dummy
+	cmds[n++] = sc->start_page;
+	cmds[n++] = interval;
+	cmds[n++] = sc->end_page;
+	if (sc->vertical) {
+		cmds[n++] = sc->vertical;
+	} else {
+		cmds[n++] = 0x00;
+		cmds[n++] = 0xFF;
+	}
+	cmds[n++] = SCROLL_ON;
+
+	mutex_lock(&lcd->lock);
+	if (!lcd->scrolling)
+		lcd_flush(lcd); // Get pending drawing out while RAM may still be written
+	ret = lcd_write_cmds(lcd, cmds, n);
+	if (!ret)
+		lcd->scrolling = true;
+	mutex_unlock(&lcd->lock);
+	return ret;
+}
+
+// The scroll leaves panel RAM shifted: resend everything
+static int scroll_stop(struct my_lcd *lcd){
+	int ret;
+
+	mutex_lock(&lcd->lock);
+	ret = lcd_write_cmds(lcd, (const u8 []){ SCROLL_OFF }, 1);
+	if (!ret && lcd->scrolling) {
+		lcd->scrolling = false;
+		lcd->shadow_valid = false;
+		lcd_dirty_add(lcd, 0, 0, lcd->width, lcd->height);
+		ret = lcd_flush(lcd);
+	}
+	mutex_unlock(&lcd->lock);
+	return ret;
+}
+
+static int scroll_set_start_line(struct my_lcd *lcd, int line){
+	int ret;
+
+	if (line < 0 || line >= lcd->height)
+		return -EINVAL;
+
+	mutex_lock(&lcd->lock);
+	ret = lcd_write_cmds(lcd, (const u8 []){ SET_START_LINE | line }, 1);
+	if (!ret)
+		lcd->start_line = line;
+	mutex_unlock(&lcd->lock);
+	return ret;
+}
+
+static int scroll_ioctl(struct my_lcd *lcd, unsigned int cmd, void __user *argp){
+	struct ssd1306_scroll sc;
+	u32 line;
+
+	switch (cmd) {
+	case SSD1306_IOC_SCROLL_START:
+		if (copy_from_user(&sc, argp, sizeof(sc)))
+			return -EFAULT;
+		return scroll_start(lcd, &sc);
+	case SSD1306_IOC_SCROLL_STOP:
+		return scroll_stop(lcd);
+	case SSD1306_IOC_SET_START_LINE:
+		if (get_user(line, (u32 __user *)argp))
+			return -EFAULT;
+		return scroll_set_start_line(lcd, line);
+	default:
+		return -ENOTTY;
+	}
+}
+
+#endif
@@ -1,96 +1,142 @@
-#include <linux/module.h>
-#include <linux/cdev.h>
-#include <linux/fs.h>
-#include <linux/uaccess.h>
-#include <linux/device.h>
-#include <linux/kdev_t.h>
-#include <linux/platform_device.h>
-#include <linux/of.h>
-#include <linux/err.h>
-#include <linux/delay.h>
-
-#define DEVICE_NAME "ssd1306_spi"
-static struct spi_device *my_spi_device;
-
-struct my_lcd {
-	struct spi_device *spi;
-	struct gpio_desc *reset_gpio;
-	struct gpio_desc *dc_gpio;
-	u8 *framebuffer;
-	int width;
-	int height;
-	struct cdev cdev;
-	struct device *device;
-};
+#include "ssd1306.h"
+#include "flush.h"
+#include "flip.h"
+#include "text.h"
+#include "draw.h"
+#include "scroll.h"
+#include "stats.h"
+#include "fbdev.h"
 
-<<<<<<< HEAD
-<<<<<<< HEAD
-static int __init my_init(void){
-	return 0;
+static void lcd_devm_put(void *lcd){
+	lcd_put(lcd);
+}
+
+// Optional u8 DT property, keeps the default if missing
+static void lcd_prop_u8(struct device *dev, const char *name, u8 *val){
+	u32 v;
+
+	if (!of_property_read_u32(dev->of_node, name, &v))
+		*val = v;
 }
 
-static void __exit my_exit(void)
-{
+// Presence-only DT flag that turns a default-on setting off
+static void lcd_prop_flag_off(struct device *dev, const char *name, bool *val){
+	if (of_property_read_bool(dev->of_node, name))
+		*val = false;
+}
+
+/* Panel configuration: defaults for the geometry, each setting can be overridden in DT */
+static void lcd_read_config(struct my_lcd *lcd){
+	struct device *dev = &lcd->spi->dev;
+
+	lcd_default_config(lcd);
+	lcd_prop_u8(dev, "clock-div", &lcd->cfg.clock_div);
+	lcd_prop_u8(dev, "multiplex", &lcd->cfg.multiplex);
+	lcd_prop_u8(dev, "display-offset", &lcd->cfg.display_offset);
+	lcd_prop_u8(dev, "com-pins", &lcd->cfg.com_pins);
+	lcd_prop_flag_off(dev, "segment-no-remap", &lcd->cfg.seg_remap);
+	lcd_prop_flag_off(dev, "com-scan-inc", &lcd->cfg.com_scan_dec);
+	lcd_prop_u8(dev, "contrast", &lcd->cfg.contrast);
+	lcd_prop_u8(dev, "precharge", &lcd->cfg.precharge);
+	lcd_prop_u8(dev, "vcomh", &lcd->cfg.vcomh);
+	if (lcd->cfg.multiplex < 15 || lcd->cfg.multiplex > 63) {
+		dev_warn(dev, "Invalid multiplex %u, using %d\n", lcd->cfg.multiplex, lcd->height - 1);
+		lcd->cfg.multiplex = lcd->height - 1;
+	}
+	dev_info(dev, "mux %u, COM pins 0x%02x, clock 0x%02x, remap %d/%d\n", lcd->cfg.multiplex + 1,
+		 lcd->cfg.com_pins, lcd->cfg.clock_div, lcd->cfg.seg_remap, lcd->cfg.com_scan_dec);
 }
 
 // Device tree
+static const struct of_device_id my_ssd1306_of_match[] = {
+	{ .compatible = "decryptec,my_SSD1306" },
+	{}
+};
+MODULE_DEVICE_TABLE(of, my_ssd1306_of_match);
+
 static const struct spi_device_id my_ssd1306_id[] = {
-	{"decryptec,my_SSD1306", 0},
+	{"my_SSD1306", 0},
 	{}
 };
 MODULE_DEVICE_TABLE(spi, my_ssd1306_id);
 
 static int my_ssd1306_probe(struct spi_device *spi){
 	struct my_lcd *lcd;
+	u32 width, height;
 	int ret;
 
 	dev_info(&spi->dev, "SSD1306 lcd probe start\n");
 
-	/* Allocate driver data */
-	lcd = devm_kzalloc(&spi->dev, sizeof(struct my_lcd), GFP_KERNEL);
+	/* Allocate driver data: refcounted, open files can use it after the unbind */
+	lcd = kzalloc(sizeof(struct my_lcd), GFP_KERNEL);
 	if (!lcd){
 		dev_err(&spi->dev, "Failed to allocate driver data\n");
 		return -ENOMEM;
 	}
+	kref_init(&lcd->ref);
+	ret = devm_add_action_or_reset(&spi->dev, lcd_devm_put, lcd);
+	if (ret)
+		return ret;
 
 	/* Store spi_device */
 	lcd->spi = spi;
+	mutex_init(&lcd->lock);
+	lcd_flip_init(lcd);
+	lcd->dc = -1;
+	lcd->max_fps = SSD1306_DEFAULT_FPS;
 
 	/* Setup GPIO referencing device tree */
 	lcd->reset_gpio = devm_gpiod_get(&spi->dev, "reset", GPIOD_OUT_HIGH);
 	if (IS_ERR(lcd->reset_gpio)){
 		dev_err(&spi->dev, "Failed to request reset GPIO\n");
-		return -1;
+		return PTR_ERR(lcd->reset_gpio);
 	}
 
 	lcd->dc_gpio = devm_gpiod_get(&spi->dev, "dc", GPIOD_OUT_HIGH);
 	if (IS_ERR(lcd->dc_gpio)){
 		dev_err(&spi->dev, "Failed to request dc GPIO\n");
-		return -1;
+		return PTR_ERR(lcd->dc_gpio);
 	}
 
 	/* Width and Height from device tree */
-	ret = of_property_read_u32(spi->dev.of_node, "width", &lcd->width);
+	ret = of_property_read_u32(spi->dev.of_node, "width", &width);
 	if (ret) {
 		dev_err(&spi->dev, "Failed to read 'width' from device tree\n");
 		return ret;
 	}
 
-	ret = of_property_read_u32(spi->dev.of_node, "height", &lcd->height);
+	ret = of_property_read_u32(spi->dev.of_node, "height", &height);
 	if (ret) {
 		dev_err(&spi->dev, "Failed to read 'height' from device tree\n");
 		return ret;
 	}
 
+	if (!width || width > SSD1306_MAX_WIDTH || width % 8 ||
+	    !height || height > SSD1306_MAX_HEIGHT || height % 8) {
+		dev_err(&spi->dev, "Unsupported geometry %ux%u\n", width, height);
+		return -EINVAL;
+	}
+	lcd->width = width;
+	lcd->height = height;
+	lcd->pages = height / 8;
+
 	dev_info(&spi->dev, "Display Width: %d, Height: %d\n", lcd->width, lcd->height);
+	lcd_read_config(lcd);
 
-	/* Allocate Framebuffer */
-	lcd->framebuffer = dezm_kazalloc(&spi->dev, (lcd->width * lcd->height / 8), GFP_KERNEL); // 1 bit per pixel
+	/* Allocate Framebuffer: page aligned (vmalloc), it is handed to fbdev. Freed with lcd. */
+	lcd->framebuffer = vzalloc(lcd->width * lcd->height / 8 * SSD1306_FRAMES); // 1 bit per pixel
 	if (!lcd->framebuffer){
 		dev_err(&spi->dev, "Failed to allocate framebuffer\n");
 		return -ENOMEM;
 	}
 
+	/* Shadow of panel RAM, data and command buffers, all sent by SPI (kmalloc is DMA-safe) */
+	lcd->shadow = devm_kzalloc(&spi->dev, lcd->width * lcd->pages, GFP_KERNEL);
+	lcd->cmd_buf = devm_kzalloc(&spi->dev, SSD1306_CMD_BUF_LEN, GFP_KERNEL);
+	lcd->tx_buf = devm_kzalloc(&spi->dev, lcd->width * lcd->pages, GFP_KERNEL);
+	if (!lcd->shadow || !lcd->cmd_buf || !lcd->tx_buf)
+		return -ENOMEM;
+
 	/* SPI Settings */
 	spi->mode = SPI_MODE_0;
 	spi->bits_per_word = 8;
@@ -107,35 +153,107 @@ static int my_ssd1306_probe(struct spi_device *spi){
 		dev_err(&spi->dev, "SPI setup failed: %d\n", ret);
 		return ret;
 	}
+	lcd_set_xfer_max(lcd);
 
 	/* Store data in spi_device */
 	spi_set_drvdata(spi, lcd);
 
 	/* LCD Init */
+	ret = lcd_init_panel(lcd);
+	if (ret) {
+		dev_err(&spi->dev, "Panel init failed: %d\n", ret);
+		return ret;
+	}
+	ret = lcd_flush_init(lcd); // Clear panel RAM
+	if (ret)
+		return ret;
+	mutex_lock(&lcd->lock);
+	ret = lcd_write_cmds(lcd, (const u8 []){ DISPLAY_ON }, 1);
+	mutex_unlock(&lcd->lock);
+	if (ret)
+		return ret;
+
+	ret = fbdev_init(lcd);
+	if (ret)
+		return ret;
+
+	ret = text_init(lcd);
+	if (ret) {
+		dev_err(&spi->dev, "Text console init failed: %d\n", ret);
+		sysfs_remove_group(&spi->dev.kobj, &ssd1306_attr_group);
+		fbdev_cleanup(lcd);
+		cancel_delayed_work_sync(&lcd->flush_work);
+		return ret;
+	}
 
+	stats_init(lcd);
 	dev_info(&spi->dev, "SSD1306 LCD probe complete\n");
 
 	return 0;
 }
 
 static void my_ssd1306_remove(struct spi_device *spi){
-	
+	struct my_lcd *lcd = spi_get_drvdata(spi);
+	u8 cmd = DISPLAY_OFF;
+
+	stats_cleanup(lcd);
+	text_cleanup(lcd);
+	sysfs_remove_group(&spi->dev.kobj, &ssd1306_attr_group);
+	fbdev_cleanup(lcd);
+	cancel_delayed_work_sync(&lcd->flush_work);
+
+	mutex_lock(&lcd->lock);
+	lcd_write_cmds(lcd, &cmd, 1);
+	lcd->dead = true; // An mmap of /dev/fbN may still fault in and run deferred I/O
+	mutex_unlock(&lcd->lock);
+	gpiod_set_value_cansleep(lcd->reset_gpio, 1); // Hold the panel in reset
+
+	dev_info(&spi->dev, "SSD1306 LCD removed\n");
 }
 
 static struct spi_driver my_ssd1306_driver = {
 	.driver = {
 		.name = "my_ssd1306",
 		.owner = THIS_MODULE,
-		.of_match_table = of_match_ptr(my_ssd1306_id), // DTO
+		.of_match_table = my_ssd1306_of_match, // DTO
 	},
 	.probe = my_ssd1306_probe,
 	.remove = my_ssd1306_remove,
 	.id_table = my_ssd1306_id,
 };
 
-module_spi_driver(my_ssd1306_driver);
+// Shared by all panels: the flush workqueue and the text console class
+static int __init my_ssd1306_init(void){
+	int ret;
+
+	ssd1306_wq = alloc_workqueue("ssd1306", WQ_UNBOUND, 0);
+	if (!ssd1306_wq)
+		return -ENOMEM;
+	ret = text_register();
+	if (ret)
+		goto err_wq;
+	ret = spi_register_driver(&my_ssd1306_driver);
+	if (ret)
+		goto err_text;
+	return 0;
+
+err_text:
+	text_unregister();
+err_wq:
+	destroy_workqueue(ssd1306_wq);
+	return ret;
+}
+
+static void __exit my_ssd1306_exit(void){
+	spi_unregister_driver(&my_ssd1306_driver);
+	text_unregister();
+	destroy_workqueue(ssd1306_wq);
+}
+
+module_init(my_ssd1306_init);
+module_exit(my_ssd1306_exit);
 
 /* Meta info */
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Decryptec");
-MODULE_DESCRIPTION(("Simple driver for SSD1306 lcd via SPI");
+MODULE_DESCRIPTION("Simple driver for SSD1306 lcd via SPI");
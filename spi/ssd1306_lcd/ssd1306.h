@@ -1,31 +1,312 @@
 #ifndef SSD1306_DRIVER_H
 #define SSD1306_DRIVER_H
 
+#include <linux/module.h>
+#include <linux/cdev.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <linux/device.h>
+#include <linux/kdev_t.h>
+#include <linux/of.h>
+#include <linux/err.h>
+#include <linux/delay.h>
+#include <linux/spi/spi.h>
+#include <linux/gpio/consumer.h>
+#include <linux/fb.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/ioctl.h>
+#include <linux/wait.h>
+#include <linux/compat.h>
+#include <linux/atomic.h>
+#include <linux/timekeeping.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/idr.h>
+#include <linux/kref.h>
+#include <linux/slab.h>
 
-#define DISPLAY_ON 0xAE
-#define DISPLAY_OFF 0xAF
-#define SCROLL_ON 0x2E
-#define SCROFF_OFF 0x2F
+#include "ssd1306_uapi.h"
 
-struct pixel_data{
-	u8 x;
-	u8 y;
-	char color;
-};
+// Fundamental commands
+#define SET_CONTRAST 0x81
+#define DISPLAY_ALL_ON_RESUME 0xA4 // Display follows RAM
+#define NORMAL_DISPLAY 0xA6
+#define INVERT_DISPLAY 0xA7
+#define DISPLAY_OFF 0xAE
+#define DISPLAY_ON 0xAF
+
+// Scrolling
+#define SCROLL_OFF 0x2E
+#define SCROLL_ON 0x2F
+#define SCROLL_RIGHT 0x26      // Horizontal: dummy, start page, interval, end page, 0x00, 0xFF
+#define SCROLL_LEFT 0x27
+#define SCROLL_VERT_RIGHT 0x29 // Diagonal: dummy, start page, interval, end page, vertical offset
+#define SCROLL_VERT_LEFT 0x2A
+#define SET_VERT_SCROLL_AREA 0xA3 // Fixed rows at the top, rows in the scroll area
+
+// Addressing
+#define SET_MEMORY_MODE 0x20 // 0x00 horizontal, 0x01 vertical, 0x02 page
+#define MEMORY_MODE_HORIZONTAL 0x00
+#define SET_COLUMN_ADDR 0x21 // Start, end column
+#define SET_PAGE_ADDR 0x22   // Start, end page
 
-void spi_write(uint8_t data);
+// Hardware configuration
+#define SET_START_LINE 0x40 // | line (0-63)
+#define SET_SEG_NORMAL 0xA0 // Column 0 mapped to SEG0
+#define SET_SEG_REMAP 0xA1  // Column 127 mapped to SEG0
+#define SET_MULTIPLEX 0xA8
+#define SET_COM_SCAN_INC 0xC0
+#define SET_COM_SCAN_DEC 0xC8
+#define SET_DISPLAY_OFFSET 0xD3
+#define SET_COM_PINS 0xDA
+#define SET_CLOCK_DIV 0xD5
+#define SET_PRECHARGE 0xD9
+#define SET_VCOM_DETECT 0xDB
+#define CHARGE_PUMP 0x8D
+#define CHARGE_PUMP_ON 0x14
+
+#define SSD1306_MAX_WIDTH 128
+#define SSD1306_MAX_HEIGHT 64
+#define SSD1306_MAX_PAGES (SSD1306_MAX_HEIGHT / 8)
+#define SSD1306_CMD_BUF_LEN 32
+#define SSD1306_DEFAULT_FPS 30 // Flush rate limit, max_fps in sysfs
+#define SSD1306_MAX_FPS 200
+#define SSD1306_TEXT_CLASS "ssd1306_class"
+#define SSD1306_TEXT_MINORS 16 // Panels per system
+#define SSD1306_BUS_SLICE_US 1000 // Longest a data message may hold a shared bus
+#define SSD1306_FRAMES 2 // fbdev double buffering: two frames stacked, flipped by panning
 
-void SetCursor();
-void GoToNextLine();
-void PrintChar();
-void String();
 void InvertDisplay();
 void SetBrightness();
 
-void Start_HorizontalScroll();
-void Start_Vert_Hort_Scroll();
-void Stop_Scroll();
-void Clear();
+// Dirty columns of one 8-row page, x0 > x1 when clean
+struct lcd_dirty {
+	u8 x0;
+	u8 x1;
+};
+
+// Panel wiring and analog settings, from DT with defaults for the common modules
+struct lcd_config {
+	u8 clock_div;      // SET_CLOCK_DIV: oscillator frequency << 4 | divide ratio - 1
+	u8 multiplex;      // Mux ratio - 1, rows driven
+	u8 display_offset; // First COM line
+	u8 com_pins;       // SET_COM_PINS: 0x12 alternative (128x64), 0x02 sequential (128x32)
+	bool seg_remap;    // Column 127 on SEG0 (mirrored horizontally)
+	bool com_scan_dec; // Scan COM from the bottom (mirrored vertically)
+	u8 contrast;
+	u8 precharge;
+	u8 vcomh;
+};
+
+// Address window: columns x0..x1 of pages p0..p1, filled in horizontal addressing order
+struct lcd_window {
+	int x0;
+	int x1;
+	int p0;
+	int p1;
+};
+
+// Bus statistics (debugfs stats), updated by flushes and flips
+struct lcd_stats {
+	atomic64_t updates;  // Flushes and flips that sent something
+	atomic64_t messages; // SPI messages
+	atomic64_t bytes;    // Bytes on the wire
+	atomic64_t busy_ns;  // First message of an update to the end of its last, summed
+};
+
+struct my_lcd {
+	struct kref ref; // Probe, plus /dev/fbN and each open text console until their last close
+	bool dead; // Unbound: the bus and the devm buffers are gone, under lock
+	struct spi_device *spi;
+	struct gpio_desc *reset_gpio;
+	struct gpio_desc *dc_gpio;
+	u8 *framebuffer; // fbdev screen memory: row-major, 1 bpp, MSB = leftmost pixel, SSD1306_FRAMES frames
+	int front_y; // First framebuffer row of the frame on the panel (0 or height)
+	int width;
+	int height;
+	int pages; // height / 8
+	struct cdev *cdev; // Text console, /dev/ssd1306_textN. Allocated: open files outlive lcd
+	struct device *device;
+	dev_t dev_num;
+	struct lcd_config cfg;
+	size_t xfer_max; // Data bytes per message, SSD1306_BUS_SLICE_US at the SPI clock
+
+	struct fb_info *info;
+	struct fb_deferred_io defio; // mmap writes, collected per memory page
+	struct mutex lock; // Serialises bus access and the shadow
+	u8 *shadow; // Panel RAM as last sent: page-major, one byte = 8 vertical pixels
+	bool shadow_valid; // False until the whole panel RAM has been written once
+	u8 *cmd_buf; // DMA-safe command bytes
+	u8 *tx_buf; // DMA-safe window data gathered from the shadow, sent in one transfer
+	int dc; // Level last driven on D/C, -1 unknown
+
+	// Regions changed since the last flush (any context, under dirty_lock)
+	spinlock_t dirty_lock;
+	struct lcd_dirty dirty[SSD1306_MAX_PAGES];
+	struct delayed_work flush_work; // At most one flush per frame period
+	unsigned int max_fps;
+
+	// Asynchronous flips (flip.h): one frame in flight at a time
+	u64 flip_start_ns;
+	size_t flip_off; // Sent so far of the flip_len bytes in tx_buf
+	size_t flip_len;
+	struct spi_message flip_msg;
+	struct spi_transfer flip_xfer;
+	bool flip_busy; // Message submitted and not completed, the bus is ours
+	wait_queue_head_t flip_wq; // Woken when a flip completes
+	u32 frames; // Completed flips
+
+	// Text console (text.h), all under lock
+	bool text_mode; // Panel shows the text screen instead of the framebuffer
+	u8 *text; // Text screen in page format, glyphs are copied in as they are
+	int cur_col;
+	int cur_row;
+	u8 esc_state;
+	int esc_args[2];
+	int esc_nargs;
+
+	// Hardware scrolling (scroll.h), under lock
+	bool scrolling; // Continuous scroll running: panel RAM must not be written
+	u8 start_line; // RAM row shown at the top of the panel
+
+	struct lcd_stats stats;
+	struct dentry *debugfs;
+};
+
+// Flushes of all panels, unbound so a panel stuck on a slow bus does not hold up the others
+static struct workqueue_struct *ssd1306_wq;
+
+// lcd and the framebuffer it hands to fbdev stay until the last open file is closed
+static void lcd_free(struct kref *ref){
+	struct my_lcd *lcd = container_of(ref, struct my_lcd, ref);
+
+	vfree(lcd->framebuffer);
+	kfree(lcd);
+}
+
+static void lcd_put(struct my_lcd *lcd){
+	kref_put(&lcd->ref, lcd_free);
+}
+
+// One frame period at max_fps, the flush coalescing window
+static unsigned long lcd_frame_delay(struct my_lcd *lcd){
+	return max_t(unsigned long, HZ / READ_ONCE(lcd->max_fps), 1);
+}
+
+// D/C must not change under an asynchronous flip: wait for it to complete
+static void lcd_wait_idle(struct my_lcd *lcd){
+	wait_event(lcd->flip_wq, !smp_load_acquire(&lcd->flip_busy));
+}
+
+// Only touch the GPIO when the level changes: once per phase, not once per message
+static void lcd_set_dc(struct my_lcd *lcd, int level){
+	if (lcd->dc == level)
+		return;
+	gpiod_set_value_cansleep(lcd->dc_gpio, level);
+	lcd->dc = level;
+}
+
+static void lcd_stats_xfer(struct my_lcd *lcd, size_t len){
+	atomic64_inc(&lcd->stats.messages);
+	atomic64_add(len, &lcd->stats.bytes);
+}
+
+// One update that started at start_ns is on the panel
+static void lcd_stats_update(struct my_lcd *lcd, u64 start_ns){
+	atomic64_inc(&lcd->stats.updates);
+	atomic64_add(ktime_get_ns() - start_ns, &lcd->stats.busy_ns);
+}
+
+// Send command bytes (D/C low). Caller holds lcd->lock.
+static int lcd_write_cmds(struct my_lcd *lcd, const u8 *cmds, size_t len){
+	int ret;
+
+	if (len > SSD1306_CMD_BUF_LEN)
+		return -EINVAL;
+	lcd_wait_idle(lcd);
+	memcpy(lcd->cmd_buf, cmds, len);
+	lcd_set_dc(lcd, 0);
+	lcd_stats_xfer(lcd, len);
+	ret = spi_write(lcd->spi, lcd->cmd_buf, len);
+	if (ret)
+		dev_err(&lcd->spi->dev, "Command write failed: %d\n", ret);
+	return ret;
+}
+
+// Send display RAM bytes (D/C high) from a DMA-safe buffer, in messages of at most xfer_max
+// bytes so that panels on other chip selects of the same controller get the bus in between.
+// Caller holds lcd->lock.
+static int lcd_write_data(struct my_lcd *lcd, const u8 *data, size_t len){
+	size_t off, n;
+	int ret;
+
+	lcd_wait_idle(lcd);
+	lcd_set_dc(lcd, 1);
+	for (off = 0; off < len; off += n) {
+		n = min(len - off, lcd->xfer_max);
+		lcd_stats_xfer(lcd, n);
+		ret = spi_write(lcd->spi, data + off, n);
+		if (ret) {
+			dev_err(&lcd->spi->dev, "Data write failed: %d\n", ret);
+			return ret;
+		}
+	}
+	return 0;
+}
+
+// Message size for the SPI clock, at least one page row so small clocks still make progress
+static void lcd_set_xfer_max(struct my_lcd *lcd){
+	lcd->xfer_max = max_t(size_t, div_u64((u64)lcd->spi->max_speed_hz / 8 * SSD1306_BUS_SLICE_US, USEC_PER_SEC),
+			      lcd->width);
+}
+
+// Configuration of the usual modules: 128x64 with alternative COM pins, 128x32 sequential
+static void lcd_default_config(struct my_lcd *lcd){
+	lcd->cfg.clock_div = 0x80; // Default oscillator, divide by 1
+	lcd->cfg.multiplex = lcd->height - 1;
+	lcd->cfg.display_offset = 0;
+	lcd->cfg.com_pins = lcd->height == 64 ? 0x12 : 0x02;
+	lcd->cfg.seg_remap = true;
+	lcd->cfg.com_scan_dec = true;
+	lcd->cfg.contrast = 0xCF;
+	lcd->cfg.precharge = 0xF1;
+	lcd->cfg.vcomh = 0x40;
+}
+
+// Hardware reset and the power-up sequence from the datasheet (charge pump enabled)
+static int lcd_init_panel(struct my_lcd *lcd){
+	const struct lcd_config *cfg = &lcd->cfg;
+	const u8 init[] = {
+		DISPLAY_OFF,
+		SET_CLOCK_DIV, cfg->clock_div,
+		SET_MULTIPLEX, cfg->multiplex,
+		SET_DISPLAY_OFFSET, cfg->display_offset,
+		SET_START_LINE | lcd->start_line,
+		CHARGE_PUMP, CHARGE_PUMP_ON,
+		SET_MEMORY_MODE, MEMORY_MODE_HORIZONTAL,
+		cfg->seg_remap ? SET_SEG_REMAP : SET_SEG_NORMAL,
+		cfg->com_scan_dec ? SET_COM_SCAN_DEC : SET_COM_SCAN_INC,
+		SET_COM_PINS, cfg->com_pins,
+		SET_CONTRAST, cfg->contrast,
+		SET_PRECHARGE, cfg->precharge,
+		SET_VCOM_DETECT, cfg->vcomh,
+		DISPLAY_ALL_ON_RESUME,
+		NORMAL_DISPLAY,
+	};
+	int ret;
+
+	gpiod_set_value_cansleep(lcd->reset_gpio, 1);
+	usleep_range(10, 20); // RES# low for at least 3 us
+	gpiod_set_value_cansleep(lcd->reset_gpio, 0);
+	usleep_range(10, 20);
+
+	mutex_lock(&lcd->lock);
+	ret = lcd_write_cmds(lcd, init, sizeof(init));
+	mutex_unlock(&lcd->lock);
+	return ret;
+}
 
 #endif
@@ -0,0 +1,70 @@
+#ifndef SSD1306_UAPI_H
+#define SSD1306_UAPI_H
+
+// Shared between the driver and userspace programs
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define SSD1306_TEXT_NAME "ssd1306_text" // Text console device nodes: /dev/ssd1306_text0, 1, ...
+
+// Drawing ioctls on /dev/fbN. Coordinates are in pixels of one frame and clipped to the
+// panel, so primitives may hang over the edges. Drawing into the front frame is flushed
+// (only the pages it touched); with SSD1306_DRAW_BACK it goes into the hidden frame of
+// the double buffer and shows up with the next FBIOPAN_DISPLAY flip.
+#define SSD1306_OP_FILL  1 // Rectangle x, y, w, h in color
+#define SSD1306_OP_HLINE 2 // w pixels from x, y
+#define SSD1306_OP_VLINE 3 // h pixels from x, y
+#define SSD1306_OP_BLIT  4 // 1 bpp image from data: h rows of (w + 7) / 8 bytes, MSB = leftmost
+
+#define SSD1306_COLOR_CLEAR  0
+#define SSD1306_COLOR_SET    1
+#define SSD1306_COLOR_INVERT 2 // BLIT: invert where the image has a 1, else copy the image
+
+struct ssd1306_draw_cmd {
+	__u8 op;    // SSD1306_OP_*
+	__u8 color; // SSD1306_COLOR_*
+	__u16 reserved;
+	__s16 x;
+	__s16 y;
+	__u16 w;
+	__u16 h;
+	__u64 data; // BLIT: user pointer to the image
+};
+
+#define SSD1306_DRAW_BACK 0x1 // Draw into the hidden frame
+
+// Many primitives, executed in order under one lock and flushed once
+struct ssd1306_draw_list {
+	__u64 cmds;  // User pointer to count struct ssd1306_draw_cmd
+	__u32 count; // At most SSD1306_DRAW_LIST_MAX
+	__u32 flags; // SSD1306_DRAW_*
+};
+#define SSD1306_DRAW_LIST_MAX 4096
+
+// Hardware scrolling on /dev/fbN: the controller moves the picture itself, a scroll costs a
+// few command bytes instead of a frame. Panel RAM must not be written while a continuous
+// scroll runs, so flushes are held back and flips fail with EBUSY until SCROLL_STOP, which
+// resends the framebuffer. The start line needs no stop: the framebuffer is panel RAM and
+// start_line picks the RAM row shown at the top, e.g. scroll a log by drawing the new line
+// into the rows that just went off screen and moving the start line down by 8.
+#define SSD1306_SCROLL_RIGHT 0
+#define SSD1306_SCROLL_LEFT  1
+
+struct ssd1306_scroll {
+	__u8 dir;         // SSD1306_SCROLL_*
+	__u8 start_page;  // Pages (8-row bands) that scroll horizontally
+	__u8 end_page;
+	__u8 vertical;    // Rows moved up per step for a diagonal scroll, 0 for horizontal only
+	__u16 frames;     // Frames per step: 2, 3, 4, 5, 25, 64, 128 or 256
+	__u8 fixed_rows;  // Diagonal: rows at the top that stay put
+	__u8 scroll_rows; // Diagonal: rows below them that scroll vertically, 0 for the rest
+};
+
+#define SSD1306_IOC_MAGIC 'S'
+#define SSD1306_IOC_DRAW      _IOW(SSD1306_IOC_MAGIC, 0x20, struct ssd1306_draw_cmd)
+#define SSD1306_IOC_DRAW_LIST _IOW(SSD1306_IOC_MAGIC, 0x21, struct ssd1306_draw_list)
+#define SSD1306_IOC_SCROLL_START   _IOW(SSD1306_IOC_MAGIC, 0x30, struct ssd1306_scroll)
+#define SSD1306_IOC_SCROLL_STOP    _IO(SSD1306_IOC_MAGIC, 0x31)
+#define SSD1306_IOC_SET_START_LINE _IOW(SSD1306_IOC_MAGIC, 0x32, __u32) // 0 - height-1
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef STATS_H
+#define STATS_H
+#include "ssd1306.h"
+
+// Bus statistics in debugfs (/sys/kernel/debug/ssd1306-<spi dev>/stats), for tests/bench.c.
+// An update is one flush or flip that sent something. wire_us is the time the bytes need at
+// the SPI clock, idle_us what the updates took beyond that: message setup, D/C toggles,
+// scheduling. Writing anything to "reset" zeroes the counters.
+
+static int lcd_stats_show(struct seq_file *m, void *v){
+	struct my_lcd *lcd = m->private;
+	u64 updates = atomic64_read(&lcd->stats.updates);
+	u64 messages = atomic64_read(&lcd->stats.messages);
+	u64 bytes = atomic64_read(&lcd->stats.bytes);
+	u64 busy_ns = atomic64_read(&lcd->stats.busy_ns);
+	u64 wire_ns = div_u64(bytes * 8 * NSEC_PER_SEC, lcd->spi->max_speed_hz);
+	u64 idle_ns = busy_ns > wire_ns ? busy_ns - wire_ns : 0;
+
+	seq_printf(m, "spi_hz: %u\n", lcd->spi->max_speed_hz);
+	seq_printf(m, "updates: %llu\n", updates);
+	seq_printf(m, "messages: %llu\n", messages);
+	seq_printf(m, "bytes: %llu\n", bytes);
+	seq_printf(m, "busy_us: %llu\n", div_u64(busy_ns, NSEC_PER_USEC));
+	seq_printf(m, "wire_us: %llu\n", div_u64(wire_ns, NSEC_PER_USEC));
+	seq_printf(m, "idle_us: %llu\n", div_u64(idle_ns, NSEC_PER_USEC));
+	if (updates) {
+		seq_printf(m, "messages_per_update: %llu\n", div64_u64(messages, updates));
+		seq_printf(m, "bytes_per_update: %llu\n", div64_u64(bytes, updates));
+		seq_printf(m, "idle_us_per_update: %llu\n", div64_u64(idle_ns, updates * NSEC_PER_USEC));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lcd_stats);
+
+static ssize_t lcd_stats_reset_write(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos){
+	struct my_lcd *lcd = file->private_data;
+
+	atomic64_set(&lcd->stats.updates, 0);
+	atomic64_set(&lcd->stats.messages, 0);
+	atomic64_set(&lcd->stats.bytes, 0);
+	atomic64_set(&lcd->stats.busy_ns, 0);
+	return count;
+}
+
+static const struct file_operations lcd_stats_reset_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = lcd_stats_reset_write,
+	.llseek = noop_llseek,
+};
+
+static void stats_init(struct my_lcd *lcd){
+	char name[32];
+
+	snprintf(name, sizeof(name), "ssd1306-%s", dev_name(&lcd->spi->dev));
+	lcd->debugfs = debugfs_create_dir(name, NULL); // Errors are ignored, as debugfs expects
+	debugfs_create_file("stats", 0444, lcd->debugfs, lcd, &lcd_stats_fops);
+	debugfs_create_file("reset", 0200, lcd->debugfs, lcd, &lcd_stats_reset_fops);
+}
+
+static void stats_cleanup(struct my_lcd *lcd){
+	debugfs_remove_recursive(lcd->debugfs);
+	lcd->debugfs = NULL;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+#include "../ssd1306_uapi.h"
+
+// Frame rate and bus efficiency at the DT spi-max-frequency.
+// Usage: bench [full|partial|flush] [frames] [/dev/fbN] [debugfs dir]
+//   full     every flip changes the whole panel (worst case, 1 KiB per frame)
+//   partial  every flip moves an 8x8 block (partial update through the shadow diff)
+//   flush    draws into the front frame, the rate-limited flush path (max_fps caps it)
+// Prints frames per second, then the driver's bus statistics: bytes and messages per
+// update and the idle time on top of the pure wire time.
+#define DEBUGFS_DIR "/sys/kernel/debug/ssd1306-spi0.0"
+
+static double now_s(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int draw(int fd, uint32_t flags, uint8_t op, uint8_t color, int x, int y, int w, int h){
+	struct ssd1306_draw_cmd c = { .op = op, .color = color, .x = x, .y = y, .w = w, .h = h };
+	struct ssd1306_draw_list list = { .cmds = (uintptr_t)&c, .count = 1, .flags = flags };
+
+	return ioctl(fd, SSD1306_IOC_DRAW_LIST, &list);
+}
+
+static void dump(const char *dir, const char *file){
+	char path[256], buf[1024];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perror(path);
+		return;
+	}
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		fwrite(buf, 1, n, stdout);
+	close(fd);
+}
+
+static void reset(const char *dir){
+	char path[256];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/reset", dir);
+	fd = open(path, O_WRONLY);
+	if (fd == -1) {
+		perror(path);
+		return;
+	}
+	if (write(fd, "1", 1) != 1)
+		perror(path);
+	close(fd);
+}
+
+int main(int argc, char **argv){
+	const char *mode = argc > 1 ? argv[1] : "full";
+	int frames = argc > 2 ? atoi(argv[2]) : 500;
+	const char *dev = argc > 3 ? argv[3] : "/dev/fb0";
+	const char *dir = argc > 4 ? argv[4] : DEBUGFS_DIR;
+	struct fb_var_screeninfo var;
+	uint32_t crtc = 0;
+	double t0, t;
+	int fd, i;
+
+	fd = open(dev, O_RDWR);
+	if (fd == -1) {
+		perror("Failed to open framebuffer");
+		return -1;
+	}
+	if (ioctl(fd, FBIOGET_VSCREENINFO, &var)) {
+		perror("FBIOGET_VSCREENINFO");
+		close(fd);
+		return -1;
+	}
+
+	// Same starting point in both frames
+	draw(fd, 0, SSD1306_OP_FILL, SSD1306_COLOR_CLEAR, 0, 0, var.xres, var.yres);
+	draw(fd, SSD1306_DRAW_BACK, SSD1306_OP_FILL, SSD1306_COLOR_CLEAR, 0, 0, var.xres, var.yres);
+	ioctl(fd, FBIO_WAITFORVSYNC, &crtc);
+	usleep(100000); // Let the rate-limited flush of the clear go out
+	reset(dir);
+
+	t0 = now_s();
+	for (i = 0; i < frames; i++) {
+		if (!strcmp(mode, "flush")) {
+			// Two small changes far apart: separate windows, or one if that is cheaper
+			draw(fd, 0, SSD1306_OP_FILL, SSD1306_COLOR_INVERT, i % (var.xres - 8), 0, 8, 8);
+			draw(fd, 0, SSD1306_OP_FILL, SSD1306_COLOR_INVERT, 0, var.yres - 8, 8, 8);
+			usleep(5000);
+			continue;
+		}
+		if (!strcmp(mode, "partial")) {
+			draw(fd, SSD1306_DRAW_BACK, SSD1306_OP_FILL, SSD1306_COLOR_CLEAR, 0, 0, var.xres, var.yres);
+			draw(fd, SSD1306_DRAW_BACK, SSD1306_OP_FILL, SSD1306_COLOR_SET,
+			     i % (var.xres - 8), (i / 8) % (var.yres - 8), 8, 8);
+		} else {
+			draw(fd, SSD1306_DRAW_BACK, SSD1306_OP_FILL, i % 2 ? SSD1306_COLOR_CLEAR : SSD1306_COLOR_SET,
+			     0, 0, var.xres, var.yres);
+		}
+		var.yoffset = var.yoffset ? 0 : var.yres;
+		if (ioctl(fd, FBIOPAN_DISPLAY, &var) || ioctl(fd, FBIO_WAITFORVSYNC, &crtc)) {
+			perror("Flip failed");
+			break;
+		}
+	}
+	t = now_s() - t0;
+	usleep(100000);
+
+	printf("mode: %s\nframes: %d\nseconds: %.3f\nfps: %.1f\n", mode, i, t, i / t);
+	dump(dir, "stats");
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+#include "../ssd1306_uapi.h"
+
+// Draw a frame, a bar graph and a blitted icon with one SSD1306_IOC_DRAW_LIST, then
+// animate the bar through the double buffer: draw into the hidden frame, wait, flip.
+// Usage: draw [/dev/fbN]
+
+static const uint8_t icon[8] = { 0x3C, 0x42, 0xA5, 0x81, 0xA5, 0x99, 0x42, 0x3C }; // 8x8
+
+static void cmd(struct ssd1306_draw_cmd *c, uint8_t op, uint8_t color, int x, int y, int w, int h){
+	*c = (struct ssd1306_draw_cmd){ .op = op, .color = color, .x = x, .y = y, .w = w, .h = h };
+}
+
+static int draw_frame(int fd, int level, uint32_t flags){
+	struct ssd1306_draw_cmd c[7];
+	struct ssd1306_draw_list list = { .cmds = (uintptr_t)c, .count = 7, .flags = flags };
+
+	cmd(&c[0], SSD1306_OP_FILL, SSD1306_COLOR_CLEAR, 0, 0, 128, 64);
+	cmd(&c[1], SSD1306_OP_HLINE, SSD1306_COLOR_SET, 0, 0, 128, 0);
+	cmd(&c[2], SSD1306_OP_HLINE, SSD1306_COLOR_SET, 0, 63, 128, 0);
+	cmd(&c[3], SSD1306_OP_VLINE, SSD1306_COLOR_SET, 0, 0, 0, 64);
+	cmd(&c[4], SSD1306_OP_VLINE, SSD1306_COLOR_SET, 127, 0, 0, 64);
+	cmd(&c[5], SSD1306_OP_FILL, SSD1306_COLOR_SET, 16, 28, level, 8);
+	cmd(&c[6], SSD1306_OP_BLIT, SSD1306_COLOR_SET, 4, 28, 8, 8);
+	c[6].data = (uintptr_t)icon;
+	return ioctl(fd, SSD1306_IOC_DRAW_LIST, &list);
+}
+
+int main(int argc, char **argv){
+	const char *dev = argc > 1 ? argv[1] : "/dev/fb0";
+	struct fb_var_screeninfo var;
+	uint32_t crtc = 0;
+	int fd, i;
+
+	fd = open(dev, O_RDWR);
+	if (fd == -1) {
+		perror("Failed to open framebuffer");
+		return -1;
+	}
+	if (draw_frame(fd, 0, 0)) {
+		perror("SSD1306_IOC_DRAW_LIST");
+		close(fd);
+		return -1;
+	}
+	if (ioctl(fd, FBIOGET_VSCREENINFO, &var)) {
+		perror("FBIOGET_VSCREENINFO");
+		close(fd);
+		return -1;
+	}
+
+	for (i = 0; i <= 100; i++) {
+		if (draw_frame(fd, i, SSD1306_DRAW_BACK))
+			break;
+		var.yoffset = var.yoffset ? 0 : var.yres; // Show the frame just drawn
+		if (ioctl(fd, FBIOPAN_DISPLAY, &var) || ioctl(fd, FBIO_WAITFORVSYNC, &crtc))
+			break;
+	}
+	if (i <= 100)
+		perror("Animation stopped");
+	close(fd);
+	return 0;
+}
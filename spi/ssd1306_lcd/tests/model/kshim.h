@@ -0,0 +1,235 @@
+#ifndef KSHIM_H
+#define KSHIM_H
+
+// Just enough of the kernel API for the driver headers to run in userspace: SPI writes and
+// the D/C GPIO go to an ssd1306_model, locks are no-ops (the tests are single threaded),
+// delayed work only records that it was queued and asynchronous messages complete at once.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <linux/types.h>
+#include "ssd1306_model.h"
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int16_t s16;
+typedef int64_t s64;
+
+#define __user
+#define THIS_MODULE NULL
+#define GFP_KERNEL 0
+#define HZ 100
+#define NSEC_PER_SEC 1000000000ULL
+#define NSEC_PER_USEC 1000ULL
+#define USEC_PER_SEC 1000000ULL
+#define U8_MAX 0xFF
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define READ_ONCE(x) (x)
+#define WRITE_ONCE(x, v) ((x) = (v))
+#define smp_load_acquire(p) (*(p))
+#define smp_store_release(p, v) (*(p) = (v))
+#define min(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); _a < _b ? _a : _b; })
+#define max(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); _a > _b ? _a : _b; })
+#define min_t(t, a, b) min((t)(a), (t)(b))
+#define max_t(t, a, b) max((t)(a), (t)(b))
+#define clamp(v, lo, hi) min(max(v, lo), hi)
+#define round_down(x, y) ((x) & ~((y) - 1))
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#define IS_ERR(p) ((unsigned long)(p) >= (unsigned long)-4095)
+#define PTR_ERR(p) ((long)(p))
+#define u64_to_user_ptr(x) ((void *)(uintptr_t)(x))
+#define div_u64(a, b) ((a) / (b))
+#define div64_u64(a, b) ((a) / (b))
+
+#define dev_err(dev, ...) ((void)(dev), fprintf(stderr, __VA_ARGS__))
+#define dev_err_ratelimited dev_err
+#define dev_info(dev, ...) ((void)(dev))
+#define dev_name(dev) ((void)(dev), "spi0.0")
+
+struct device { int unused; };
+struct dentry { int unused; };
+struct class { int unused; };
+struct file_operations;
+struct cdev {
+	void *owner;
+	const struct file_operations *ops;
+};
+struct fb_info { int unused; };
+struct fb_deferred_io { int unused; };
+
+// Locks and waits: nothing runs concurrently, a wait must already be satisfied
+struct mutex { int unused; };
+#define mutex_init(m) ((void)(m))
+#define mutex_lock(m) ((void)(m))
+#define mutex_unlock(m) ((void)(m))
+#define DEFINE_MUTEX(name) struct mutex name
+typedef struct { int unused; } spinlock_t;
+#define spin_lock_init(l) ((void)(l))
+#define spin_lock_irqsave(l, f) ((void)(l), (f) = 0)
+#define spin_unlock_irqrestore(l, f) ((void)(l), (void)(f))
+typedef struct { int unused; } wait_queue_head_t;
+#define init_waitqueue_head(wq) ((void)(wq))
+#define wake_up_all(wq) ((void)(wq))
+#define wait_event(wq, cond) do { if (!(cond)) abort(); } while (0)
+#define wait_event_interruptible(wq, cond) ({ if (!(cond)) abort(); 0; })
+
+// Delayed work: queued means pending, tests run it with run_delayed_work()
+struct work_struct { int unused; };
+struct delayed_work {
+	struct work_struct work;
+	void (*fn)(struct work_struct *work);
+	bool pending;
+};
+#define INIT_DELAYED_WORK(w, f) ((w)->fn = (f), (w)->pending = false)
+#define to_delayed_work(w) container_of(w, struct delayed_work, work)
+static inline bool schedule_delayed_work(struct delayed_work *w, unsigned long delay){
+	bool queued = !w->pending;
+
+	(void)delay;
+	w->pending = true;
+	return queued;
+}
+struct workqueue_struct { int unused; };
+#define queue_delayed_work(wq, w, delay) ((void)(wq), schedule_delayed_work(w, delay))
+static inline void run_delayed_work(struct delayed_work *w){
+	if (w->pending) {
+		w->pending = false;
+		w->fn(&w->work);
+	}
+}
+
+typedef struct { long long counter; } atomic64_t;
+#define atomic64_inc(a) ((a)->counter++)
+#define atomic64_add(v, a) ((a)->counter += (v))
+#define atomic64_read(a) ((a)->counter)
+#define atomic64_set(a, v) ((a)->counter = (v))
+
+static inline u64 ktime_get_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+#define usleep_range(min, max) ((void)0)
+
+// GPIOs: the D/C line drives the model, reset is ignored
+struct gpio_desc {
+	struct ssd1306_model *model;
+	bool is_dc;
+};
+static inline void gpiod_set_value_cansleep(struct gpio_desc *desc, int value){
+	if (desc->is_dc)
+		model_set_dc(desc->model, value);
+}
+
+// SPI: every message is one transaction on the model
+struct spi_device {
+	struct device dev;
+	u32 max_speed_hz;
+	u8 mode;
+	u8 bits_per_word;
+	struct ssd1306_model *model;
+};
+struct spi_transfer {
+	const void *tx_buf;
+	unsigned int len;
+};
+struct spi_message {
+	struct spi_transfer *xfers;
+	unsigned int n;
+	void (*complete)(void *context);
+	void *context;
+	int status;
+};
+static inline void spi_message_init_with_transfers(struct spi_message *m, struct spi_transfer *xfers, unsigned int n){
+	memset(m, 0, sizeof(*m));
+	m->xfers = xfers;
+	m->n = n;
+}
+static inline int spi_write(struct spi_device *spi, const void *buf, size_t len){
+	model_write(spi->model, buf, len);
+	return 0;
+}
+static inline int spi_async(struct spi_device *spi, struct spi_message *m){
+	unsigned int i;
+
+	for (i = 0; i < m->n; i++)
+		model_write(spi->model, m->xfers[i].tx_buf, m->xfers[i].len);
+	m->status = 0;
+	m->complete(m->context);
+	return 0;
+}
+
+// Userspace pointers are plain pointers here
+#define copy_from_user(to, from, n) (memcpy(to, from, n), 0)
+#define get_user(x, p) ((x) = *(p), 0)
+#define devm_kzalloc(dev, size, gfp) calloc(1, size)
+#define kfree(p) free(p)
+#define vfree(p) free(p)
+
+// Reference counts, single threaded
+struct kref { int refcount; };
+#define kref_init(k) ((k)->refcount = 1)
+#define kref_get(k) ((k)->refcount++)
+#define kref_put(k, release) (--(k)->refcount ? 0 : ((release)(k), 1))
+
+// Character device plumbing of text.h, nothing behind it
+struct inode { dev_t i_rdev; };
+struct file { void *private_data; };
+struct file_operations {
+	void *owner;
+	int (*open)(struct inode *inode, struct file *file);
+	int (*release)(struct inode *inode, struct file *file);
+	ssize_t (*write)(struct file *file, const char __user *buf, size_t count, loff_t *ppos);
+	loff_t (*llseek)(struct file *file, loff_t offset, int whence);
+};
+static inline loff_t noop_llseek(struct file *file, loff_t offset, int whence){
+	(void)file;
+	(void)whence;
+	return offset;
+}
+static struct class shim_class;
+static struct device shim_device;
+#define alloc_chrdev_region(devt, first, count, name) (*(devt) = 0, 0)
+#define unregister_chrdev_region(devt, count) ((void)0)
+#define class_create(name) (&shim_class)
+#define class_destroy(cls) ((void)(cls))
+#define cdev_alloc() ((struct cdev *)calloc(1, sizeof(struct cdev)))
+#define cdev_add(cdev, devt, count) 0
+#define cdev_del(cdev) free(cdev)
+#define device_create(cls, parent, devt, drvdata, ...) (&shim_device)
+#define device_destroy(cls, devt) ((void)0)
+#define MINORBITS 20
+#define MKDEV(ma, mi) (((ma) << MINORBITS) | (mi))
+#define MAJOR(dev) ((unsigned int)(dev) >> MINORBITS)
+#define MINOR(dev) ((unsigned int)(dev) & ((1U << MINORBITS) - 1))
+#define iminor(inode) MINOR((inode)->i_rdev)
+
+// Minor numbers: a bitmap is plenty for the tests
+struct ida { unsigned long used; };
+#define DEFINE_IDA(name) struct ida name
+static inline int ida_alloc_max(struct ida *ida, unsigned int max, int gfp){
+	unsigned int id;
+
+	(void)gfp;
+	for (id = 0; id <= max; id++) {
+		if (!(ida->used & 1UL << id)) {
+			ida->used |= 1UL << id;
+			return id;
+		}
+	}
+	return -ENOSPC;
+}
+#define ida_free(ida, id) ((ida)->used &= ~(1UL << (id)))
+#define ida_destroy(ida) ((ida)->used = 0)
+
+#endif
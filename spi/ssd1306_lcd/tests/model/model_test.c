@@ -0,0 +1,337 @@
+// Host tests: the driver's flush, flip, drawing, text and scroll code against the SSD1306
+// model, checking what ends up in panel RAM and what it cost on the bus.
+// Build and run from this directory:
+//   gcc -Wall -Wno-unused-function -O2 -Iinclude -I. -o model_test model_test.c ssd1306_model.c
+//   ./model_test
+// include/ holds one-line stand-ins for the kernel headers, all of them pull in kshim.h.
+#include "../../ssd1306.h"
+#include "../../flush.h"
+#include "../../flip.h"
+#include "../../text.h"
+#include "../../draw.h"
+#include "../../scroll.h"
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                   \
+	if (!(cond)) {                                          \
+		failures++;                                     \
+		printf("FAIL %s:%d: ", __func__, __LINE__);     \
+		printf(__VA_ARGS__);                            \
+		printf("\n");                                   \
+	}                                                       \
+} while (0)
+
+static struct ssd1306_model model, model_b;
+static struct gpio_desc dc_gpio = { .model = &model, .is_dc = true };
+static struct gpio_desc dc_gpio_b = { .model = &model_b, .is_dc = true };
+static struct gpio_desc reset_gpio = { .model = &model };
+static struct spi_device spi = { .max_speed_hz = 10000000, .model = &model };
+static struct spi_device spi_b = { .max_speed_hz = 1000000, .model = &model_b };
+
+// What probe does, minus fbdev: panel B is a 128x32 on a 1 MHz chip select
+static struct my_lcd *lcd_setup_panel(bool b){
+	struct my_lcd *lcd = calloc(1, sizeof(*lcd));
+
+	kref_init(&lcd->ref);
+	model_reset(b ? &model_b : &model);
+	lcd->spi = b ? &spi_b : &spi;
+	lcd->dc_gpio = b ? &dc_gpio_b : &dc_gpio;
+	lcd->reset_gpio = &reset_gpio;
+	mutex_init(&lcd->lock);
+	lcd_flip_init(lcd);
+	lcd->dc = -1;
+	lcd->max_fps = SSD1306_DEFAULT_FPS;
+	lcd->width = 128;
+	lcd->height = b ? 32 : 64;
+	lcd->pages = lcd->height / 8;
+	lcd_default_config(lcd);
+	lcd_set_xfer_max(lcd);
+	lcd->framebuffer = calloc(SSD1306_FRAMES, lcd->width * lcd->height / 8);
+	lcd->shadow = calloc(1, lcd->width * lcd->pages);
+	lcd->cmd_buf = calloc(1, SSD1306_CMD_BUF_LEN);
+	lcd->tx_buf = calloc(1, lcd->width * lcd->pages);
+	text_init(lcd);
+
+	lcd_init_panel(lcd);
+	lcd_flush_init(lcd);
+	return lcd;
+}
+
+static struct my_lcd *lcd_setup(void){
+	return lcd_setup_panel(false);
+}
+
+static void lcd_teardown(struct my_lcd *lcd){
+	text_cleanup(lcd);
+	free(lcd->framebuffer);
+	free(lcd->shadow);
+	free(lcd->cmd_buf);
+	free(lcd->tx_buf);
+	free(lcd->text);
+	free(lcd);
+}
+
+static int fb_pixel(struct my_lcd *lcd, int frame_y, int x, int y){
+	return lcd->framebuffer[(frame_y + y) * (lcd->width / 8) + x / 8] >> (7 - x % 8) & 1;
+}
+
+// Panel RAM against the framebuffer frame starting at row frame_y, returns mismatches
+static int compare(struct my_lcd *lcd, int frame_y){
+	int x, y, bad = 0;
+
+	for (y = 0; y < lcd->height; y++)
+		for (x = 0; x < lcd->width; x++)
+			bad += fb_pixel(lcd, frame_y, x, y) != model_pixel(lcd->spi->model, x, y);
+	return bad;
+}
+
+static int draw(struct my_lcd *lcd, u32 flags, u8 op, u8 color, int x, int y, int w, int h){
+	struct ssd1306_draw_cmd c = { .op = op, .color = color, .x = x, .y = y, .w = w, .h = h };
+
+	return draw_cmds(lcd, &c, 1, flags);
+}
+
+static void test_init(void){
+	struct my_lcd *lcd = lcd_setup();
+
+	CHECK(!model.errors, "%lu protocol errors", model.errors);
+	CHECK(model.mode == 0, "horizontal addressing expected, got mode %d", model.mode);
+	CHECK(model.data_bytes == 1024, "initial clear sent %lu bytes", model.data_bytes);
+	CHECK(compare(lcd, 0) == 0, "panel differs from the framebuffer");
+	lcd_teardown(lcd);
+}
+
+static void test_partial_update(void){
+	struct my_lcd *lcd = lcd_setup();
+
+	model_clear_counters(&model);
+	draw(lcd, 0, SSD1306_OP_FILL, SSD1306_COLOR_SET, 10, 3, 8, 8); // Straddles pages 0 and 1
+	CHECK(lcd->flush_work.pending, "drawing did not queue a flush");
+	run_delayed_work(&lcd->flush_work);
+
+	CHECK(compare(lcd, 0) == 0, "panel differs from the framebuffer");
+	CHECK(model.data_bytes == 16, "8 columns on 2 pages should be 16 bytes, got %lu", model.data_bytes);
+	CHECK(model.transactions == 2, "one window is 2 messages, got %lu", model.transactions);
+	CHECK(model.dc_changes <= 2, "%lu D/C changes for one window", model.dc_changes);
+
+	// Nothing changed: nothing sent
+	model_clear_counters(&model);
+	draw(lcd, 0, SSD1306_OP_FILL, SSD1306_COLOR_SET, 10, 3, 8, 8);
+	run_delayed_work(&lcd->flush_work);
+	CHECK(model.transactions == 0, "unchanged pixels sent %lu messages", model.transactions);
+	lcd_teardown(lcd);
+}
+
+static void test_window_planning(void){
+	struct my_lcd *lcd = lcd_setup();
+
+	// Far apart: two windows beat one window over the whole panel
+	model_clear_counters(&model);
+	draw(lcd, 0, SSD1306_OP_FILL, SSD1306_COLOR_SET, 0, 0, 4, 8);
+	draw(lcd, 0, SSD1306_OP_FILL, SSD1306_COLOR_SET, 120, 56, 4, 8);
+	run_delayed_work(&lcd->flush_work);
+	CHECK(compare(lcd, 0) == 0, "panel differs from the framebuffer");
+	CHECK(model.transactions == 4, "expected 2 windows, got %lu messages", model.transactions);
+	CHECK(model.data_bytes == 8, "expected 8 bytes, got %lu", model.data_bytes);
+
+	// Neighbouring pages with overlapping columns: one window
+	model_clear_counters(&model);
+	draw(lcd, 0, SSD1306_OP_FILL, SSD1306_COLOR_SET, 40, 16, 10, 8);
+	draw(lcd, 0, SSD1306_OP_FILL, SSD1306_COLOR_SET, 42, 24, 10, 8);
+	run_delayed_work(&lcd->flush_work);
+	CHECK(compare(lcd, 0) == 0, "panel differs from the framebuffer");
+	CHECK(model.transactions == 2, "expected 1 window, got %lu messages", model.transactions);
+	lcd_teardown(lcd);
+}
+
+static void test_draw_clipping(void){
+	static const u8 image[2 * 16] = { [0 ... 31] = 0xA5 };
+	struct ssd1306_draw_cmd cmds[] = {
+		{ .op = SSD1306_OP_FILL, .color = SSD1306_COLOR_SET, .x = -5, .y = -5, .w = 20, .h = 20 },
+		{ .op = SSD1306_OP_HLINE, .color = SSD1306_COLOR_INVERT, .x = 100, .y = 63, .w = 100 },
+		{ .op = SSD1306_OP_VLINE, .color = SSD1306_COLOR_SET, .x = 127, .y = 30, .h = 100 },
+		{ .op = SSD1306_OP_BLIT, .color = SSD1306_COLOR_SET, .x = 120, .y = 40, .w = 13, .h = 16,
+		  .data = (uintptr_t)image },
+		{ .op = SSD1306_OP_FILL, .color = SSD1306_COLOR_CLEAR, .x = 2, .y = 2, .w = 4, .h = 4 },
+	};
+	struct ssd1306_draw_list list = { .cmds = (uintptr_t)cmds, .count = ARRAY_SIZE(cmds) };
+	struct my_lcd *lcd = lcd_setup();
+	int ret;
+
+	ret = draw_ioctl(lcd, SSD1306_IOC_DRAW_LIST, &list);
+	CHECK(ret == 0, "draw list failed: %d", ret);
+	run_delayed_work(&lcd->flush_work);
+	CHECK(compare(lcd, 0) == 0, "panel differs from the framebuffer");
+	CHECK(model_pixel(&model, 0, 0) && model_pixel(&model, 14, 14) && !model_pixel(&model, 15, 15),
+	      "clipped fill is off");
+	CHECK(!model_pixel(&model, 3, 3), "clear inside the fill missing");
+	CHECK(model_pixel(&model, 127, 63) && model_pixel(&model, 127, 30), "vertical line missing");
+	CHECK(model_pixel(&model, 120, 40) && !model_pixel(&model, 121, 40), "blit bits wrong");
+
+	CHECK(draw(lcd, 0, 9, 0, 0, 0, 1, 1) == -EINVAL, "bad op accepted");
+	lcd_teardown(lcd);
+}
+
+static void test_flip(void){
+	struct my_lcd *lcd = lcd_setup();
+	int ret;
+
+	// Draw the hidden frame: nothing goes out until the flip
+	model_clear_counters(&model);
+	draw(lcd, SSD1306_DRAW_BACK, SSD1306_OP_FILL, SSD1306_COLOR_SET, 0, 0, 128, 64);
+	CHECK(!lcd->flush_work.pending && model.transactions == 0, "back buffer drawing was flushed");
+
+	ret = lcd_flip(lcd, lcd->height);
+	CHECK(ret == 0, "flip failed: %d", ret);
+	CHECK(!lcd->flip_busy && lcd->frames == 1, "flip did not complete");
+	CHECK(lcd_flip_wait(lcd) == 0, "vsync wait failed");
+	CHECK(compare(lcd, lcd->height) == 0, "panel differs from the new front frame");
+	CHECK(model.transactions == 2 && model.data_bytes == 1024, "full flip: %lu messages, %lu bytes",
+	      model.transactions, model.data_bytes);
+
+	// Back to a frame that differs in one block: only that block's window
+	model_clear_counters(&model);
+	draw(lcd, SSD1306_DRAW_BACK, SSD1306_OP_FILL, SSD1306_COLOR_SET, 0, 0, 128, 64);
+	draw(lcd, SSD1306_DRAW_BACK, SSD1306_OP_FILL, SSD1306_COLOR_CLEAR, 64, 32, 8, 8);
+	lcd_flip(lcd, 0);
+	CHECK(compare(lcd, 0) == 0, "panel differs from the new front frame");
+	CHECK(model.data_bytes == 8, "partial flip sent %lu bytes", model.data_bytes);
+	lcd_teardown(lcd);
+}
+
+static void test_text(void){
+	const char msg[] = "\fHi\n\033[3;2Hx\033[1;1HA";
+	struct my_lcd *lcd = lcd_setup();
+	int i;
+
+	lcd_set_text_mode(lcd, true);
+	for (i = 0; msg[i]; i++)
+		text_putc(lcd, msg[i]);
+	lcd_flush(lcd);
+
+	CHECK(!memcmp(model.ram[0], ssd1306_font['A' - FONT_FIRST], FONT_WIDTH), "A not at row 1, col 1");
+	CHECK(!memcmp(model.ram[0] + FONT_WIDTH, ssd1306_font['i' - FONT_FIRST], FONT_WIDTH), "i not after it");
+	CHECK(!memcmp(model.ram[2] + FONT_WIDTH, ssd1306_font['x' - FONT_FIRST], FONT_WIDTH), "x not at row 3, col 2");
+	CHECK(lcd->cur_row == 0 && lcd->cur_col == 1, "cursor at %d,%d", lcd->cur_row, lcd->cur_col);
+
+	// Scrolling the console moves whole pages
+	for (i = 0; i < lcd->pages; i++)
+		text_putc(lcd, '\n');
+	lcd_flush(lcd);
+	CHECK(model.ram[0][0] == 0, "console did not scroll");
+
+	// The framebuffer takes over again on request
+	lcd_set_text_mode(lcd, false);
+	lcd_flush(lcd);
+	CHECK(compare(lcd, 0) == 0, "panel differs from the framebuffer");
+	lcd_teardown(lcd);
+}
+
+// An open console outlives the unbind: its writes fail and its close drops the last reference
+static void test_text_unbind(void){
+	struct my_lcd *lcd = lcd_setup();
+	struct inode inode = { .i_rdev = lcd->dev_num };
+	struct file file = { 0 }, late = { 0 };
+
+	CHECK(ssd1306_text_fops.open(&inode, &file) == 0 && file.private_data == lcd, "open failed");
+	CHECK(ssd1306_text_fops.write(&file, "A", 1, NULL) == 1, "write failed");
+
+	// What remove does, then the devm put
+	text_cleanup(lcd);
+	lcd->dead = true;
+	lcd->ref.refcount--;
+	CHECK(ssd1306_text_fops.open(&inode, &late) == -ENODEV, "open after unbind");
+	model_clear_counters(&model);
+	CHECK(ssd1306_text_fops.write(&file, "B", 1, NULL) == -ENODEV, "write after unbind");
+	CHECK(lcd_flush(lcd) == -ENODEV && model.data_bytes == 0, "flush after unbind");
+	CHECK(lcd->ref.refcount == 1, "open file holds %d references", lcd->ref.refcount);
+	free(lcd->shadow);
+	free(lcd->cmd_buf);
+	free(lcd->tx_buf);
+	free(lcd->text);
+	ssd1306_text_fops.release(&inode, &file); // Frees lcd and the framebuffer
+}
+
+static void test_scroll(void){
+	struct ssd1306_scroll sc = { .dir = SSD1306_SCROLL_LEFT, .start_page = 7, .end_page = 7, .frames = 2 };
+	struct my_lcd *lcd = lcd_setup();
+	u32 line;
+
+	CHECK(scroll_start(lcd, &sc) == 0, "scroll start failed");
+	CHECK(model.scrolling, "model not scrolling");
+
+	// Drawing is held back while the controller scrolls
+	model_clear_counters(&model);
+	draw(lcd, 0, SSD1306_OP_FILL, SSD1306_COLOR_SET, 0, 0, 8, 8);
+	run_delayed_work(&lcd->flush_work);
+	CHECK(model.data_bytes == 0, "RAM written during a scroll");
+	CHECK(lcd_flip(lcd, lcd->height) == -EBUSY, "flip allowed during a scroll");
+
+	CHECK(scroll_stop(lcd) == 0, "scroll stop failed");
+	CHECK(!model.scrolling && !model.errors, "stop: scrolling %d, %lu errors", model.scrolling, model.errors);
+	CHECK(compare(lcd, 0) == 0, "panel not restored after the scroll");
+
+	line = 8;
+	CHECK(scroll_ioctl(lcd, SSD1306_IOC_SET_START_LINE, &line) == 0 && model.start_line == 8,
+	      "start line not set");
+	CHECK(scroll_set_start_line(lcd, 64) == -EINVAL, "start line 64 accepted");
+	sc.frames = 7;
+	CHECK(scroll_start(lcd, &sc) == -EINVAL, "bad interval accepted");
+	lcd_teardown(lcd);
+}
+
+static void test_multi_panel(void){
+	struct my_lcd *a = lcd_setup();
+	struct my_lcd *b = lcd_setup_panel(true);
+
+	CHECK(model.multiplex == 63 && model.com_pins == 0x12, "128x64: mux %d, COM pins 0x%02x",
+	      model.multiplex, model.com_pins);
+	CHECK(model_b.multiplex == 31 && model_b.com_pins == 0x02, "128x32: mux %d, COM pins 0x%02x",
+	      model_b.multiplex, model_b.com_pins);
+	CHECK(a->dev_num != b->dev_num, "both panels got minor %u", MINOR(a->dev_num));
+
+	// Panel B at 1 MHz: a full update is cut into bus slices, panel A at 10 MHz is not
+	CHECK(a->xfer_max >= 1024 && b->xfer_max == 128, "xfer_max %zu / %zu", a->xfer_max, b->xfer_max);
+	model_clear_counters(&model);
+	model_clear_counters(&model_b);
+	draw(a, 0, SSD1306_OP_FILL, SSD1306_COLOR_SET, 0, 0, 128, 64);
+	draw(b, 0, SSD1306_OP_FILL, SSD1306_COLOR_SET, 0, 0, 128, 32);
+	run_delayed_work(&a->flush_work);
+	run_delayed_work(&b->flush_work);
+	CHECK(compare(a, 0) == 0, "panel A differs from its framebuffer");
+	CHECK(model.transactions == 2, "panel A: %lu messages", model.transactions);
+	CHECK(model_b.data_bytes == 512 && model_b.transactions == 1 + 4, "panel B: %lu bytes in %lu messages",
+	      model_b.data_bytes, model_b.transactions);
+	CHECK(!model.errors && !model_b.errors, "protocol errors %lu / %lu", model.errors, model_b.errors);
+
+	// A flip on the slow panel goes out in slices too, one completion chaining the next
+	model_clear_counters(&model_b);
+	draw(b, SSD1306_DRAW_BACK, SSD1306_OP_FILL, SSD1306_COLOR_CLEAR, 0, 0, 128, 32);
+	CHECK(lcd_flip(b, b->height) == 0 && b->frames == 1, "flip on panel B failed");
+	CHECK(model_b.data_bytes == 512 && model_b.transactions == 1 + 4, "flip B: %lu bytes in %lu messages",
+	      model_b.data_bytes, model_b.transactions);
+	CHECK(model_pixel(&model_b, 0, 0) == 0, "flip B not on the panel");
+
+	lcd_teardown(b);
+	lcd_teardown(a);
+}
+
+int main(void){
+	test_init();
+	test_partial_update();
+	test_window_planning();
+	test_draw_clipping();
+	test_flip();
+	test_text();
+	test_text_unbind();
+	test_scroll();
+	test_multi_panel();
+
+	if (failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("All model tests passed\n");
+	return 0;
+}
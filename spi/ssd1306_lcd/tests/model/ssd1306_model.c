@@ -0,0 +1,156 @@
+#include <string.h>
+#include "ssd1306_model.h"
+
+void model_reset(struct ssd1306_model *m){
+	memset(m, 0, sizeof(*m));
+	m->dc = -1;
+	m->col_end = MODEL_WIDTH - 1;
+	m->page_end = MODEL_PAGES - 1;
+	m->mode = 2; // Page addressing after reset
+	m->multiplex = 63;
+	m->com_pins = 0x12;
+}
+
+void model_clear_counters(struct ssd1306_model *m){
+	m->transactions = 0;
+	m->cmd_bytes = 0;
+	m->data_bytes = 0;
+	m->dc_changes = 0;
+	m->errors = 0;
+}
+
+void model_set_dc(struct ssd1306_model *m, int level){
+	if (m->dc != level)
+		m->dc_changes++;
+	m->dc = level;
+}
+
+int model_pixel(const struct ssd1306_model *m, int x, int y){
+	return m->ram[y / 8][x] >> (y % 8) & 1;
+}
+
+// Parameter bytes that follow each opcode
+static int cmd_params(uint8_t op){
+	switch (op) {
+	case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+	case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+		return 1;
+	case 0x21: case 0x22: case 0xA3:
+		return 2;
+	case 0x29: case 0x2A:
+		return 5;
+	case 0x26: case 0x27:
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+static void run_cmd(struct ssd1306_model *m){
+	const uint8_t *c = m->cmd;
+
+	switch (c[0]) {
+	case 0x20:
+		m->mode = c[1] & 3;
+		break;
+	case 0x21:
+		m->col_start = c[1] & 0x7F;
+		m->col_end = c[2] & 0x7F;
+		m->col = m->col_start;
+		break;
+	case 0x22:
+		m->page_start = c[1] & 7;
+		m->page_end = c[2] & 7;
+		m->page = m->page_start;
+		break;
+	case 0x26: case 0x27: case 0x29: case 0x2A: case 0xA3:
+		if (m->scrolling)
+			m->errors++; // Scroll setup must come after deactivation
+		break;
+	case 0xA8:
+		m->multiplex = c[1] & 0x3F;
+		break;
+	case 0xDA:
+		m->com_pins = c[1];
+		break;
+	case 0x2E:
+		m->scrolling = false;
+		break;
+	case 0x2F:
+		m->scrolling = true;
+		break;
+	case 0xAE:
+		m->display_on = false;
+		break;
+	case 0xAF:
+		m->display_on = true;
+		break;
+	default:
+		if (c[0] >= 0x40 && c[0] <= 0x7F)
+			m->start_line = c[0] & 0x3F;
+		else if (c[0] >= 0xB0 && c[0] <= 0xB7 && m->mode == 2)
+			m->page = c[0] & 7;
+		else if (c[0] <= 0x0F && m->mode == 2)
+			m->col = (m->col & 0xF0) | c[0];
+		else if (c[0] >= 0x10 && c[0] <= 0x1F && m->mode == 2)
+			m->col = (m->col & 0x0F) | (c[0] & 0x0F) << 4;
+		break;
+	}
+}
+
+static void cmd_byte(struct ssd1306_model *m, uint8_t b){
+	m->cmd_bytes++;
+	m->cmd[m->cmd_len++] = b;
+	if (m->cmd_len == 1)
+		m->cmd_need = cmd_params(b);
+	else
+		m->cmd_need--;
+	if (!m->cmd_need) {
+		run_cmd(m);
+		m->cmd_len = 0;
+	}
+}
+
+static void data_byte(struct ssd1306_model *m, uint8_t b){
+	m->data_bytes++;
+	if (m->scrolling)
+		m->errors++;
+	m->ram[m->page][m->col] = b;
+
+	switch (m->mode) {
+	case 0: // Horizontal: along the column window, then the next page
+		if (++m->col > m->col_end) {
+			m->col = m->col_start;
+			if (++m->page > m->page_end)
+				m->page = m->page_start;
+		}
+		break;
+	case 1: // Vertical: down the page window, then the next column
+		if (++m->page > m->page_end) {
+			m->page = m->page_start;
+			if (++m->col > m->col_end)
+				m->col = m->col_start;
+		}
+		break;
+	default: // Page: along the page, wrapping to the start column
+		if (++m->col > m->col_end)
+			m->col = m->col_start;
+		break;
+	}
+}
+
+void model_write(struct ssd1306_model *m, const uint8_t *buf, size_t len){
+	size_t i;
+
+	m->transactions++;
+	if (m->dc < 0) {
+		m->errors++;
+		return;
+	}
+	for (i = 0; i < len; i++) {
+		if (m->dc)
+			data_byte(m, buf[i]);
+		else
+			cmd_byte(m, buf[i]);
+	}
+}
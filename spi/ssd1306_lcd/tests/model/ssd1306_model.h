@@ -0,0 +1,47 @@
+#ifndef SSD1306_MODEL_H
+#define SSD1306_MODEL_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Software model of an SSD1306 on 4-wire SPI: D/C plus the bytes of each transaction.
+// Commands are decoded (addressing modes, windows, start line, scrolling, display on/off),
+// data lands in a 128x64 GDDRAM, and all traffic is counted.
+
+#define MODEL_WIDTH 128
+#define MODEL_PAGES 8
+
+struct ssd1306_model {
+	uint8_t ram[MODEL_PAGES][MODEL_WIDTH]; // GDDRAM: page-major, bit 0 = top row of the page
+	int dc; // D/C level: 0 command, 1 data, -1 never driven
+
+	// Address pointer and window
+	int mode; // 0 horizontal, 1 vertical, 2 page
+	int col, page;
+	int col_start, col_end, page_start, page_end;
+
+	int start_line;
+	int multiplex; // Rows driven - 1
+	int com_pins;
+	bool display_on;
+	bool scrolling;
+
+	// Command parser: opcode and parameters still expected
+	uint8_t cmd[8];
+	int cmd_len, cmd_need;
+
+	// Traffic
+	unsigned long transactions;
+	unsigned long cmd_bytes;
+	unsigned long data_bytes;
+	unsigned long dc_changes;
+	unsigned long errors; // Data with D/C never driven, RAM writes while scrolling, bad commands
+};
+
+void model_reset(struct ssd1306_model *m);
+void model_set_dc(struct ssd1306_model *m, int level);
+void model_write(struct ssd1306_model *m, const uint8_t *buf, size_t len); // One transaction
+void model_clear_counters(struct ssd1306_model *m);
+int model_pixel(const struct ssd1306_model *m, int x, int y); // RAM coordinates
+
+#endif
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+#include "../ssd1306_uapi.h"
+
+// Hardware scrolling: scroll the bottom page as a ticker for a few seconds, then scroll
+// the whole panel up a text row at a time with the start line, 8 rows per command byte.
+// Usage: scroll [/dev/fbN]
+
+static int fill(int fd, uint8_t color, int x, int y, int w, int h){
+	struct ssd1306_draw_cmd c = { .op = SSD1306_OP_FILL, .color = color, .x = x, .y = y, .w = w, .h = h };
+
+	return ioctl(fd, SSD1306_IOC_DRAW, &c);
+}
+
+int main(int argc, char **argv){
+	const char *dev = argc > 1 ? argv[1] : "/dev/fb0";
+	struct ssd1306_scroll sc = {
+		.dir = SSD1306_SCROLL_LEFT,
+		.start_page = 7,
+		.end_page = 7,
+		.frames = 2,
+	};
+	struct fb_var_screeninfo var;
+	uint32_t line;
+	int fd, i;
+
+	fd = open(dev, O_RDWR);
+	if (fd == -1) {
+		perror("Failed to open framebuffer");
+		return -1;
+	}
+	if (ioctl(fd, FBIOGET_VSCREENINFO, &var)) {
+		perror("FBIOGET_VSCREENINFO");
+		close(fd);
+		return -1;
+	}
+
+	// Ticker: a dashed bottom row, moved by the controller
+	fill(fd, SSD1306_COLOR_CLEAR, 0, 0, var.xres, var.yres);
+	for (i = 0; i < (int)var.xres; i += 16)
+		fill(fd, SSD1306_COLOR_SET, i, var.yres - 6, 8, 4);
+	usleep(100000); // Let the flush go out before the scroll locks panel RAM
+	if (ioctl(fd, SSD1306_IOC_SCROLL_START, &sc)) {
+		perror("SSD1306_IOC_SCROLL_START");
+		close(fd);
+		return -1;
+	}
+	sleep(3);
+	if (ioctl(fd, SSD1306_IOC_SCROLL_STOP))
+		perror("SSD1306_IOC_SCROLL_STOP");
+
+	// Start line: one bar per text row, then roll them up a row at a time
+	fill(fd, SSD1306_COLOR_CLEAR, 0, 0, var.xres, var.yres);
+	for (i = 0; i < (int)var.yres / 8; i++)
+		fill(fd, SSD1306_COLOR_SET, 0, i * 8 + 2, (i + 1) * var.xres / (var.yres / 8), 4);
+	usleep(100000);
+	for (i = 1; i <= 16; i++) {
+		line = i * 8 % var.yres;
+		if (ioctl(fd, SSD1306_IOC_SET_START_LINE, &line)) {
+			perror("SSD1306_IOC_SET_START_LINE");
+			break;
+		}
+		usleep(250000);
+	}
+	close(fd);
+	return 0;
+}
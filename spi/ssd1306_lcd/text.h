@@ -0,0 +1,305 @@
+#ifndef TEXT_H
+#define TEXT_H
+#include "ssd1306.h"
+#include "flush.h"
+#include "font.h"
+
+// Text console: write a string to /dev/ssd1306_textN (one per panel) and it shows up in a
+// 6x8 character grid (21x8 on a 128x64 panel). The font is stored in the panel's page format, so a glyph is a
+// FONT_WIDTH byte memcpy into the text screen and the flush sends it without conversion.
+// Writing to the console switches the panel to the text screen, writing to or flipping the
+// framebuffer switches it back. Control characters and escapes:
+//   \n new line, \r column 0, \b back one column, \t next multiple of 4, \f clear and home
+//   ESC [ row ; col H  cursor to row, col (from 1)   ESC [ n A/B/C/D  up/down/right/left
+//   ESC [ J  clear screen   ESC [ K  clear to end of line   ESC c  reset
+// The cursor is not drawn. Past the last row the screen scrolls up one text row.
+
+#define TEXT_TAB 4
+
+enum text_esc_state {
+	TEXT_NORMAL,
+	TEXT_ESC, // After ESC
+	TEXT_CSI, // After ESC [
+};
+
+static int text_cols(struct my_lcd *lcd){
+	return lcd->width / FONT_WIDTH;
+}
+
+static void text_set_cursor(struct my_lcd *lcd, int row, int col){
+	lcd->cur_row = clamp(row, 0, lcd->pages - 1);
+	lcd->cur_col = clamp(col, 0, text_cols(lcd) - 1);
+}
+
+static void text_clear(struct my_lcd *lcd){
+	memset(lcd->text, 0, lcd->width * lcd->pages);
+	lcd_dirty_add(lcd, 0, 0, lcd->width, lcd->height);
+	lcd->cur_row = 0;
+	lcd->cur_col = 0;
+}
+
+// Clear the current text row from column col on
+static void text_clear_line(struct my_lcd *lcd, int col){
+	u8 *row = lcd->text + lcd->cur_row * lcd->width;
+
+	memset(row + col * FONT_WIDTH, 0, lcd->width - col * FONT_WIDTH);
+	lcd_dirty_add(lcd, col * FONT_WIDTH, lcd->cur_row * 8, lcd->width - col * FONT_WIDTH, 8);
+}
+
+// A text row is one page, scrolling is a memmove of whole pages
+static void text_next_line(struct my_lcd *lcd){
+	lcd->cur_col = 0;
+	if (lcd->cur_row < lcd->pages - 1) {
+		lcd->cur_row++;
+		return;
+	}
+	memmove(lcd->text, lcd->text + lcd->width, lcd->width * (lcd->pages - 1));
+	memset(lcd->text + lcd->width * (lcd->pages - 1), 0, lcd->width);
+	lcd_dirty_add(lcd, 0, 0, lcd->width, lcd->height);
+}
+
+// Draw a printable character at the cursor and advance, wrapping at the end of the row
+static void text_print_char(struct my_lcd *lcd, char c){
+	int x = lcd->cur_col * FONT_WIDTH;
+
+	if (c < FONT_FIRST || c > FONT_LAST)
+		c = '?';
+	memcpy(lcd->text + lcd->cur_row * lcd->width + x, ssd1306_font[c - FONT_FIRST], FONT_WIDTH);
+	lcd_dirty_add(lcd, x, lcd->cur_row * 8, FONT_WIDTH, 8);
+
+	if (++lcd->cur_col >= text_cols(lcd))
+		text_next_line(lcd);
+}
+
+// Final byte of ESC [ ... : missing or zero args count as 1
+static void text_csi(struct my_lcd *lcd, char c){
+	int a0 = max(lcd->esc_nargs > 0 ? lcd->esc_args[0] : 0, 1);
+	int a1 = max(lcd->esc_nargs > 1 ? lcd->esc_args[1] : 0, 1);
+	int n = a0;
+
+	switch (c) {
+	case 'H':
+	case 'f':
+		text_set_cursor(lcd, a0 - 1, a1 - 1);
+		break;
+	case 'A':
+		text_set_cursor(lcd, lcd->cur_row - n, lcd->cur_col);
+		break;
+	case 'B':
+		text_set_cursor(lcd, lcd->cur_row + n, lcd->cur_col);
+		break;
+	case 'C':
+		text_set_cursor(lcd, lcd->cur_row, lcd->cur_col + n);
+		break;
+	case 'D':
+		text_set_cursor(lcd, lcd->cur_row, lcd->cur_col - n);
+		break;
+	case 'J':
+		text_clear(lcd);
+		break;
+	case 'K':
+		text_clear_line(lcd, lcd->cur_col);
+		break;
+	default:
+		break; // Unsupported, ignored
+	}
+}
+
+// Feed one byte through the escape parser. Caller holds lcd->lock.
+static void text_putc(struct my_lcd *lcd, char c){
+	switch (lcd->esc_state) {
+	case TEXT_ESC:
+		lcd->esc_state = TEXT_NORMAL;
+		if (c == '[') {
+			lcd->esc_state = TEXT_CSI;
+			lcd->esc_nargs = 0;
+			lcd->esc_args[0] = 0;
+			lcd->esc_args[1] = 0;
+		} else if (c == 'c') {
+			text_clear(lcd);
+		}
+		return;
+	case TEXT_CSI:
+		if (c >= '0' && c <= '9') {
+			if (!lcd->esc_nargs)
+				lcd->esc_nargs = 1;
+			if (lcd->esc_nargs <= 2)
+				lcd->esc_args[lcd->esc_nargs - 1] =
+					min(lcd->esc_args[lcd->esc_nargs - 1] * 10 + c - '0', 999);
+		} else if (c == ';') {
+			lcd->esc_nargs = min(max(lcd->esc_nargs, 1) + 1, 3); // 3: extra args, ignored
+		} else {
+			text_csi(lcd, c);
+			lcd->esc_state = TEXT_NORMAL;
+		}
+		return;
+	default:
+		break;
+	}
+
+	switch (c) {
+	case '\033':
+		lcd->esc_state = TEXT_ESC;
+		break;
+	case '\n':
+		text_next_line(lcd);
+		break;
+	case '\r':
+		lcd->cur_col = 0;
+		break;
+	case '\b':
+		text_set_cursor(lcd, lcd->cur_row, lcd->cur_col - 1);
+		break;
+	case '\t':
+		lcd->cur_col = min(round_down(lcd->cur_col + TEXT_TAB, TEXT_TAB), text_cols(lcd) - 1);
+		break;
+	case '\f':
+		text_clear(lcd);
+		break;
+	default:
+		text_print_char(lcd, c);
+		break;
+	}
+}
+
+// All panels share one class and minor range, each console gets the next free minor
+static struct class *ssd1306_class;
+static dev_t ssd1306_devt;
+static DEFINE_IDA(ssd1306_ida);
+static struct my_lcd *ssd1306_text_lcd[SSD1306_TEXT_MINORS]; // By minor, NULL once unbound
+static DEFINE_MUTEX(ssd1306_text_lock);
+
+// An open console keeps lcd, after the unbind its writes fail with -ENODEV
+static int ssd1306_text_open(struct inode *inode, struct file *file){
+	struct my_lcd *lcd;
+
+	mutex_lock(&ssd1306_text_lock);
+	lcd = ssd1306_text_lcd[iminor(inode) - MINOR(ssd1306_devt)];
+	if (lcd)
+		kref_get(&lcd->ref);
+	mutex_unlock(&ssd1306_text_lock);
+	if (!lcd)
+		return -ENODEV;
+	file->private_data = lcd;
+	return 0;
+}
+
+static int ssd1306_text_release(struct inode *inode, struct file *file){
+	lcd_put(file->private_data);
+	return 0;
+}
+
+static ssize_t ssd1306_text_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos){
+	struct my_lcd *lcd = file->private_data;
+	char chunk[64];
+	size_t done = 0, n, i;
+
+	if (!count)
+		return 0;
+
+	mutex_lock(&lcd->lock);
+	if (lcd->dead) {
+		mutex_unlock(&lcd->lock);
+		return -ENODEV;
+	}
+	lcd_set_text_mode(lcd, true);
+	while (done < count) {
+		n = min(count - done, sizeof(chunk));
+		if (copy_from_user(chunk, buf + done, n))
+			break;
+		for (i = 0; i < n; i++)
+			text_putc(lcd, chunk[i]);
+		done += n;
+	}
+	mutex_unlock(&lcd->lock);
+
+	if (!done)
+		return -EFAULT; // Only a fault stops the loop before the first chunk
+	lcd_queue_flush(lcd);
+	return done;
+}
+
+static const struct file_operations ssd1306_text_fops = {
+	.owner = THIS_MODULE,
+	.open = ssd1306_text_open,
+	.release = ssd1306_text_release,
+	.write = ssd1306_text_write,
+	.llseek = noop_llseek,
+};
+
+// Module init, before any probe
+static int text_register(void){
+	int ret;
+
+	ret = alloc_chrdev_region(&ssd1306_devt, 0, SSD1306_TEXT_MINORS, SSD1306_TEXT_NAME);
+	if (ret < 0)
+		return ret;
+	ssd1306_class = class_create(SSD1306_TEXT_CLASS);
+	if (IS_ERR(ssd1306_class)) {
+		unregister_chrdev_region(ssd1306_devt, SSD1306_TEXT_MINORS);
+		return PTR_ERR(ssd1306_class);
+	}
+	return 0;
+}
+
+static void text_unregister(void){
+	class_destroy(ssd1306_class);
+	unregister_chrdev_region(ssd1306_devt, SSD1306_TEXT_MINORS);
+	ida_destroy(&ssd1306_ida);
+}
+
+static int text_init(struct my_lcd *lcd){
+	struct spi_device *spi = lcd->spi;
+	int id, ret;
+
+	lcd->text = devm_kzalloc(&spi->dev, lcd->width * lcd->pages, GFP_KERNEL);
+	if (!lcd->text)
+		return -ENOMEM;
+
+	id = ida_alloc_max(&ssd1306_ida, SSD1306_TEXT_MINORS - 1, GFP_KERNEL);
+	if (id < 0) {
+		dev_err(&spi->dev, "No free text console minor: %d\n", id);
+		return id;
+	}
+	lcd->dev_num = MKDEV(MAJOR(ssd1306_devt), MINOR(ssd1306_devt) + id);
+
+	lcd->cdev = cdev_alloc();
+	if (!lcd->cdev) {
+		ret = -ENOMEM;
+		goto err_ida;
+	}
+	lcd->cdev->owner = THIS_MODULE;
+	lcd->cdev->ops = &ssd1306_text_fops;
+	ret = cdev_add(lcd->cdev, lcd->dev_num, 1);
+	if (ret < 0)
+		goto err_cdev;
+	lcd->device = device_create(ssd1306_class, &spi->dev, lcd->dev_num, lcd, SSD1306_TEXT_NAME "%d", id);
+	if (IS_ERR(lcd->device)) {
+		ret = PTR_ERR(lcd->device);
+		goto err_cdev;
+	}
+	mutex_lock(&ssd1306_text_lock);
+	ssd1306_text_lcd[id] = lcd;
+	mutex_unlock(&ssd1306_text_lock);
+	return 0;
+
+err_cdev:
+	cdev_del(lcd->cdev);
+err_ida:
+	ida_free(&ssd1306_ida, id);
+	return ret;
+}
+
+// New opens fail from here on, files already open hold their own reference to lcd
+static void text_cleanup(struct my_lcd *lcd){
+	int id = MINOR(lcd->dev_num) - MINOR(ssd1306_devt);
+
+	mutex_lock(&ssd1306_text_lock);
+	ssd1306_text_lcd[id] = NULL;
+	mutex_unlock(&ssd1306_text_lock);
+	device_destroy(ssd1306_class, lcd->dev_num);
+	cdev_del(lcd->cdev);
+	ida_free(&ssd1306_ida, id);
+}
+
+#endif
@@ -4,9 +4,72 @@
 #include <linux/property.h>
 #include <linux/of_device.h>
 #include <linux/serdev.h>
-#include <linux/delay.h>  // for msleep()
+#include <linux/kfifo.h>
+#include <linux/workqueue.h>
+#include <linux/string.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
+#include <linux/kref.h>
+#include <linux/slab.h>
 
-#define MAX_BUFFER_SIZE 256
+#include "echo_uapi.h"
+#include "frame.h"
+
+#define MSG_FIFO_SIZE 8192  // Frames waiting for read(), header and payload each
+#define TX_FIFO_SIZE 2048   // Encoded frames waiting for the UART
+#define DEFAULT_SPEED 115200 // Without current-speed in DT
+
+// Per-UART state, several Arduinos can be attached at once. Open files keep it alive past
+// remove(): the device holds one reference, each open file another.
+struct echo_dev {
+    struct serdev_device *serdev;
+    struct miscdevice misc;
+    struct kref ref;
+    bool dead; // Unbound: fops fail with -ENODEV, set under tx_lock
+
+    // Line settings from DT, changeable in sysfs
+    struct mutex link_lock;
+    unsigned int speed; // As set, may differ a little from the requested rate
+    bool flow_control;  // RTS/CTS
+    enum serdev_parity parity;
+
+    // Frame being received, only touched by receive_buf (serialised by the tty layer)
+    u8 frame[ECHO_WIRE_MAX];
+    size_t frame_len;
+    bool frame_overflow; // Too long, skip to the next delimiter
+    u64 rx_ts;           // Arrival of the current receive_buf chunk
+    u8 rx_seq;           // seq of the last good frame
+    bool rx_seq_valid;
+    struct {
+        struct echo_msg hdr;
+        u8 data[ECHO_PAYLOAD_MAX];
+    } rx_msg; // Staging for msg_fifo
+
+    // Frames for read(): receive_buf is the only producer, readers hold read_lock
+    STRUCT_KFIFO_REC_2(MSG_FIFO_SIZE) msg_fifo;
+    struct mutex read_lock;
+    wait_queue_head_t read_wait;
+
+    // Encoded frames: producers hold tx_lock, tx_work is the only consumer
+    DECLARE_KFIFO(tx_fifo, u8, TX_FIFO_SIZE);
+    struct mutex tx_lock;
+    u8 tx_seq;
+    u8 tx_wire[ECHO_WIRE_MAX];
+    struct work_struct tx_work;
+    wait_queue_head_t write_wait;
+
+    // Statistics
+    unsigned long frames;
+    unsigned long corrupt;  // Bad COBS, CRC or length
+    unsigned long lost;     // Sum of sequence gaps
+    unsigned long dropped;  // Frames lost because nobody read them
+    unsigned long pong_dropped; // PINGs not answered because the TX FIFO was full
+};
 
 static int ser_echo_probe(struct serdev_device *serdev);
 static void ser_echo_remove(struct serdev_device *serdev);
@@ -17,74 +80,480 @@ static const struct of_device_id ser_echo_ids[] = {
 };
 MODULE_DEVICE_TABLE(of, ser_echo_ids);
 
-static int serdev_echo_recv(struct serdev_device *serdev, const unsigned char *buffer, size_t size)
+// Encode a frame with the next seq and queue it in one piece, so frames never interleave.
+// tx_lock held, false if ECHO_WIRE_MAX bytes do not fit.
+static bool echo_queue_frame(struct echo_dev *edev, u8 type, const u8 *payload, size_t len)
 {
-    static char rx_buffer[MAX_BUFFER_SIZE];
-    static size_t rx_index = 0;
+    size_t n;
 
-    size_t i;
-    for (i = 0; i < size; i++) {
-        if (rx_index < MAX_BUFFER_SIZE - 1) {
-            char c = buffer[i];
-            rx_buffer[rx_index++] = c;
+    if (kfifo_avail(&edev->tx_fifo) < ECHO_WIRE_MAX)
+        return false;
+    n = frame_encode(type, edev->tx_seq++, payload, len, edev->tx_wire);
+    kfifo_in(&edev->tx_fifo, edev->tx_wire, n);
+    schedule_work(&edev->tx_work);
+    return true;
+}
+
+// A complete frame is in edev->frame: decode, check and hand it to readers
+static void echo_frame(struct echo_dev *edev)
+{
+    typeof(edev->rx_msg) *msg = &edev->rx_msg;
+    int len;
+    u8 gap;
+
+    len = cobs_decode(edev->frame, edev->frame_len);
+    if (!frame_valid(edev->frame, len)) {
+        edev->corrupt++;
+        return;
+    }
+    len -= 4; // Payload only
+
+    // Sequence gaps: frames lost on the line (or dropped as corrupt above)
+    if (edev->frame[0] == ECHO_TYPE_HELLO)
+        edev->rx_seq_valid = false;
+    gap = edev->rx_seq_valid ? (u8)(edev->frame[1] - edev->rx_seq - 1) : 0;
+    edev->rx_seq = edev->frame[1];
+    edev->rx_seq_valid = true;
+    edev->lost += gap;
+    edev->frames++;
+
+    if (edev->frame[0] == ECHO_TYPE_PING) { // Answered here, readers do not see it
+        mutex_lock(&edev->tx_lock);
+        if (!echo_queue_frame(edev, ECHO_TYPE_PONG, edev->frame + 2, len))
+            edev->pong_dropped++;
+        mutex_unlock(&edev->tx_lock);
+        return;
+    }
 
-            if (c == '\n') {
-                rx_buffer[rx_index - 1] = '\0'; // Terminate string
-                pr_info("echo - Received message: %s\n", rx_buffer);
-                rx_index = 0;
-            }
+    msg->hdr.timestamp_ns = edev->rx_ts;
+    msg->hdr.len = len;
+    msg->hdr.type = edev->frame[0];
+    msg->hdr.seq = edev->frame[1];
+    msg->hdr.lost = gap;
+    memcpy(msg->data, edev->frame + 2, len);
+
+    if (kfifo_in(&edev->msg_fifo, msg, sizeof(msg->hdr) + len))
+        wake_up_interruptible(&edev->read_wait);
+    else
+        edev->dropped++;
+}
+
+// Incremental decoder: memchr finds each delimiter, the bytes before it are added to the
+// frame. A frame that grows past ECHO_WIRE_MAX is garbage, the next 0 resynchronises.
+static void echo_assemble(struct echo_dev *edev, const u8 *data, size_t len)
+{
+    const u8 *end;
+    size_t n;
+
+    while (len) {
+        end = memchr(data, 0, len);
+        n = end ? end - data : len;
+
+        if (edev->frame_len + n > sizeof(edev->frame)) {
+            edev->frame_overflow = true;
         } else {
-            pr_warn("echo - Buffer overflow, resetting\n");
-            rx_index = 0;
+            memcpy(edev->frame + edev->frame_len, data, n);
+            edev->frame_len += n;
         }
+        if (!end)
+            break;
+
+        if (edev->frame_overflow)
+            edev->corrupt++;
+        else if (edev->frame_len) // Empty frames are idle delimiters
+            echo_frame(edev);
+        edev->frame_len = 0;
+        edev->frame_overflow = false;
+        data = end + 1;
+        len -= n + 1;
+    }
+}
+
+// Runs in the tty flip buffer work, so decoding here is cheap and stamps are accurate
+static int serdev_echo_recv(struct serdev_device *serdev, const unsigned char *buffer, size_t size)
+{
+    struct echo_dev *edev = serdev_device_get_drvdata(serdev);
+
+    edev->rx_ts = ktime_get_ns();
+    echo_assemble(edev, buffer, size);
+    return size;
+}
+
+// Move queued bytes into the tty, write_wakeup brings us back when it has room again
+static void echo_tx_work(struct work_struct *work)
+{
+    struct echo_dev *edev = container_of(work, struct echo_dev, tx_work);
+    u8 buf[64];
+    unsigned int n;
+    int sent;
+
+    while ((n = kfifo_out_peek(&edev->tx_fifo, buf, sizeof(buf)))) {
+        sent = serdev_device_write_buf(edev->serdev, buf, n);
+        if (sent <= 0)
+            break;
+        kfifo_out(&edev->tx_fifo, buf, sent); // Drop what the tty took
+        wake_up_interruptible(&edev->write_wait);
     }
+}
 
-    return serdev_device_write_buf(serdev, buffer, size); // echo back (optional)
+static void serdev_echo_write_wakeup(struct serdev_device *serdev)
+{
+    struct echo_dev *edev = serdev_device_get_drvdata(serdev);
+
+    schedule_work(&edev->tx_work);
 }
 
+static void echo_free(struct kref *ref)
+{
+    kfree(container_of(ref, struct echo_dev, ref));
+}
+
+static struct echo_dev *echo_from_file(struct file *file)
+{
+    return file->private_data;
+}
+
+// misc_open() holds misc_mtx around this, so it cannot race with misc_deregister()
+static int echo_open(struct inode *inode, struct file *file)
+{
+    struct echo_dev *edev = container_of(file->private_data, struct echo_dev, misc);
+
+    kref_get(&edev->ref);
+    file->private_data = edev;
+    return nonseekable_open(inode, file);
+}
+
+static int echo_release(struct inode *inode, struct file *file)
+{
+    kref_put(&echo_from_file(file)->ref, echo_free);
+    return 0;
+}
+
+static ssize_t echo_read(struct file *file, char __user *ubuf, size_t count, loff_t *ppos)
+{
+    struct echo_dev *edev = echo_from_file(file);
+    unsigned int copied;
+    size_t total = 0;
+    int ret = 0;
+
+    if (count < ECHO_READ_MIN)
+        return -EINVAL;
+
+    if (mutex_lock_interruptible(&edev->read_lock))
+        return -ERESTARTSYS;
+    while (kfifo_is_empty(&edev->msg_fifo)) {
+        mutex_unlock(&edev->read_lock);
+        if (READ_ONCE(edev->dead))
+            return -ENODEV;
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(edev->read_wait, !kfifo_is_empty(&edev->msg_fifo) ||
+                                       READ_ONCE(edev->dead));
+        if (ret)
+            return ret;
+        if (mutex_lock_interruptible(&edev->read_lock))
+            return -ERESTARTSYS;
+    }
+
+    // Whole messages while they fit
+    while (!kfifo_is_empty(&edev->msg_fifo) &&
+           kfifo_peek_len(&edev->msg_fifo) <= count - total) {
+        ret = kfifo_to_user(&edev->msg_fifo, ubuf + total, count - total, &copied);
+        if (ret)
+            break;
+        total += copied;
+    }
+    mutex_unlock(&edev->read_lock);
+
+    return total ? total : ret;
+}
+
+static ssize_t echo_write(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos)
+{
+    struct echo_dev *edev = echo_from_file(file);
+    u8 body[ECHO_WRITE_MAX];
+    int ret;
+
+    if (!count || count > ECHO_WRITE_MAX)
+        return -EMSGSIZE;
+    if (copy_from_user(body, ubuf, count))
+        return -EFAULT;
+
+    for (;;) {
+        if (mutex_lock_interruptible(&edev->tx_lock))
+            return -ERESTARTSYS;
+        if (edev->dead) { // remove() may have cancelled tx_work already
+            mutex_unlock(&edev->tx_lock);
+            return -ENODEV;
+        }
+        if (echo_queue_frame(edev, body[0], body + 1, count - 1))
+            break;
+        mutex_unlock(&edev->tx_lock);
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(edev->write_wait,
+                                       kfifo_avail(&edev->tx_fifo) >= ECHO_WIRE_MAX ||
+                                       READ_ONCE(edev->dead));
+        if (ret)
+            return ret;
+    }
+    mutex_unlock(&edev->tx_lock);
+
+    return count;
+}
+
+static __poll_t echo_poll(struct file *file, poll_table *wait)
+{
+    struct echo_dev *edev = echo_from_file(file);
+    __poll_t mask = 0;
+
+    poll_wait(file, &edev->read_wait, wait);
+    poll_wait(file, &edev->write_wait, wait);
+    if (READ_ONCE(edev->dead))
+        return EPOLLHUP | EPOLLERR;
+    if (!kfifo_is_empty(&edev->msg_fifo))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    if (kfifo_avail(&edev->tx_fifo) >= ECHO_WIRE_MAX)
+        mask |= EPOLLOUT | EPOLLWRNORM;
+    return mask;
+}
+
+static const char * const echo_parity_names[] = {
+    [SERDEV_PARITY_NONE] = "none",
+    [SERDEV_PARITY_EVEN] = "even",
+    [SERDEV_PARITY_ODD] = "odd",
+};
+
+// Line settings from the echodev node: current-speed, flow-control and parity
+static void echo_read_link(struct echo_dev *edev)
+{
+    struct device *dev = &edev->serdev->dev;
+    const char *parity;
+    int i;
+
+    edev->speed = DEFAULT_SPEED;
+    device_property_read_u32(dev, "current-speed", &edev->speed);
+    edev->flow_control = device_property_read_bool(dev, "flow-control");
+    edev->parity = SERDEV_PARITY_NONE;
+    if (!device_property_read_string(dev, "parity", &parity)) {
+        i = match_string(echo_parity_names, ARRAY_SIZE(echo_parity_names), parity);
+        if (i >= 0)
+            edev->parity = i;
+        else
+            pr_warn("echo - Unknown parity \"%s\", using none\n", parity);
+    }
+}
+
+// sysfs - Baud rate, e.g. 1000000 or 2000000 for sensor streaming. Reads back the rate
+// the UART actually runs at.
+static ssize_t baudrate_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct echo_dev *edev = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(edev->speed));
+}
+
+static ssize_t baudrate_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct echo_dev *edev = dev_get_drvdata(dev);
+    unsigned int speed;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &speed);
+    if (ret)
+        return ret;
+    if (!speed)
+        return -EINVAL;
+
+    mutex_lock(&edev->link_lock);
+    WRITE_ONCE(edev->speed, serdev_device_set_baudrate(edev->serdev, speed));
+    mutex_unlock(&edev->link_lock);
+    return count;
+}
+static DEVICE_ATTR_RW(baudrate);
+
+// sysfs - RTS/CTS flow control, 0 or 1
+static ssize_t flow_control_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct echo_dev *edev = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%d\n", READ_ONCE(edev->flow_control));
+}
+
+static ssize_t flow_control_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct echo_dev *edev = dev_get_drvdata(dev);
+    bool enable;
+    int ret;
+
+    ret = kstrtobool(buf, &enable);
+    if (ret)
+        return ret;
+
+    mutex_lock(&edev->link_lock);
+    serdev_device_set_flow_control(edev->serdev, enable);
+    WRITE_ONCE(edev->flow_control, enable);
+    mutex_unlock(&edev->link_lock);
+    return count;
+}
+static DEVICE_ATTR_RW(flow_control);
+
+// sysfs - Parity: none, even or odd
+static ssize_t parity_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct echo_dev *edev = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%s\n", echo_parity_names[READ_ONCE(edev->parity)]);
+}
+
+static ssize_t parity_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct echo_dev *edev = dev_get_drvdata(dev);
+    int i, ret;
+
+    i = sysfs_match_string(echo_parity_names, buf);
+    if (i < 0)
+        return i;
+
+    mutex_lock(&edev->link_lock);
+    ret = serdev_device_set_parity(edev->serdev, i);
+    if (!ret)
+        WRITE_ONCE(edev->parity, i);
+    mutex_unlock(&edev->link_lock);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(parity);
+
+// sysfs - Frame counters, to check a benchmark run or a noisy line
+static ssize_t stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct echo_dev *edev = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "frames: %lu\ncorrupt: %lu\nlost: %lu\ndropped: %lu\npong_dropped: %lu\n",
+                      READ_ONCE(edev->frames), READ_ONCE(edev->corrupt), READ_ONCE(edev->lost),
+                      READ_ONCE(edev->dropped), READ_ONCE(edev->pong_dropped));
+}
+static DEVICE_ATTR_RO(stats);
+
+static struct attribute *echo_attrs[] = {
+    &dev_attr_baudrate.attr,
+    &dev_attr_flow_control.attr,
+    &dev_attr_parity.attr,
+    &dev_attr_stats.attr,
+    NULL,
+};
+
+static const struct attribute_group echo_attr_group = {
+    .attrs = echo_attrs,
+};
+
+static const struct file_operations echo_fops = {
+    .owner = THIS_MODULE,
+    .open = echo_open,
+    .release = echo_release,
+    .read = echo_read,
+    .write = echo_write,
+    .poll = echo_poll,
+    .llseek = noop_llseek,
+};
+
 static const struct serdev_device_ops ser_echo_ops = {
     .receive_buf = serdev_echo_recv,
+    .write_wakeup = serdev_echo_write_wakeup,
 };
 
 static int ser_echo_probe(struct serdev_device *serdev)
 {
+    struct echo_dev *edev;
     int status;
 
     pr_info("echo - Probe called\n");
 
+    edev = kzalloc(sizeof(*edev), GFP_KERNEL);
+    if (!edev)
+        return -ENOMEM;
+    edev->serdev = serdev;
+    kref_init(&edev->ref);
+    mutex_init(&edev->link_lock);
+    INIT_KFIFO(edev->msg_fifo);
+    mutex_init(&edev->read_lock);
+    init_waitqueue_head(&edev->read_wait);
+    INIT_KFIFO(edev->tx_fifo);
+    mutex_init(&edev->tx_lock);
+    INIT_WORK(&edev->tx_work, echo_tx_work);
+    init_waitqueue_head(&edev->write_wait);
+    serdev_device_set_drvdata(serdev, edev);
+
     serdev_device_set_client_ops(serdev, &ser_echo_ops);
 
     status = serdev_device_open(serdev);
     if (status) {
         pr_err("echo - Error opening serial port (%d)\n", status);
-        return -status;
+        goto err_free;
     }
 
-    pr_info("echo - Configuring UART\n");
-
-    serdev_device_set_baudrate(serdev, 115200);
-    serdev_device_set_flow_control(serdev, false);
-    serdev_device_set_parity(serdev, SERDEV_PARITY_NONE);
+    echo_read_link(edev);
+    edev->speed = serdev_device_set_baudrate(serdev, edev->speed);
+    serdev_device_set_flow_control(serdev, edev->flow_control);
+    status = serdev_device_set_parity(serdev, edev->parity);
+    if (status) {
+        pr_err("echo - Parity %s not supported (%d)\n", echo_parity_names[edev->parity], status);
+        goto err_close;
+    }
+    pr_info("echo - UART at %u baud, flow control %s, parity %s\n", edev->speed,
+            edev->flow_control ? "on" : "off", echo_parity_names[edev->parity]);
 
-    msleep(100); // Allow Arduino time to boot/reset
+    // No waiting for the Arduino to boot: it sends HELLO once it listens, and LED frames
+    // come from userspace through the device node
+    status = sysfs_create_group(&serdev->dev.kobj, &echo_attr_group);
+    if (status) {
+        pr_err("echo - Error creating sysfs attributes (%d)\n", status);
+        goto err_close;
+    }
 
-    // Send initial command
-    const char* ON_cmd = "ON\n";
-    int bytes_sent = serdev_device_write_buf(serdev, ON_cmd, strlen(ON_cmd));
-    pr_info("echo - Sent LED_ON (%d bytes)\n", bytes_sent);
+    edev->misc.minor = MISC_DYNAMIC_MINOR;
+    edev->misc.name = devm_kasprintf(&serdev->dev, GFP_KERNEL, ECHO_DEV_PREFIX "%s",
+                                     dev_name(&serdev->dev));
+    edev->misc.fops = &echo_fops;
+    edev->misc.parent = &serdev->dev;
+    status = edev->misc.name ? misc_register(&edev->misc) : -ENOMEM;
+    if (status) {
+        pr_err("echo - Error registering device node (%d)\n", status);
+        sysfs_remove_group(&serdev->dev.kobj, &echo_attr_group);
+        goto err_close;
+    }
+    pr_info("echo - Frames on /dev/%s\n", edev->misc.name);
 
     return 0;
+
+err_close:
+    serdev_device_close(serdev);
+err_free:
+    kfree(edev);
+    return status;
 }
 
 static void ser_echo_remove(struct serdev_device *serdev)
 {
+    struct echo_dev *edev = serdev_device_get_drvdata(serdev);
+
     pr_info("echo - Remove called\n");
 
-    const char* OFF_cmd = "OFF\n";
-    int bytes_sent = serdev_device_write_buf(serdev, OFF_cmd, strlen(OFF_cmd));
-    pr_info("echo - Sent LED_OFF (%d bytes)\n", bytes_sent);
+    misc_deregister(&edev->misc); // No new opens
+    sysfs_remove_group(&serdev->dev.kobj, &echo_attr_group);
+    serdev_device_close(serdev); // No more receive_buf calls: no PONGs, no new frames
 
-    serdev_device_close(serdev);
+    // Files still open: fail their fops from now on and kick out sleepers
+    mutex_lock(&edev->tx_lock);
+    WRITE_ONCE(edev->dead, true);
+    mutex_unlock(&edev->tx_lock);
+    wake_up_interruptible_all(&edev->read_wait);
+    wake_up_interruptible_all(&edev->write_wait);
+
+    cancel_work_sync(&edev->tx_work); // Nothing can queue it any more
+    pr_info("echo - %lu frames, %lu corrupt, %lu lost, %lu dropped, %lu PINGs not answered\n",
+            edev->frames, edev->corrupt, edev->lost, edev->dropped, edev->pong_dropped);
+    kref_put(&edev->ref, echo_free);
 }
 
 static struct serdev_device_driver serdev_device_driver = {
@@ -0,0 +1,42 @@
+#ifndef ECHO_UAPI_H
+#define ECHO_UAPI_H
+
+// Shared between the driver and userspace programs, uno_sender.ino mirrors the protocol
+#include <linux/types.h>
+
+#define ECHO_DEV_PREFIX "echo-" // One node per UART: /dev/echo-serial0-0, ...
+
+// Wire format, both directions: COBS(type, seq, payload, crc16) followed by a 0 delimiter.
+// seq counts frames per direction and wraps at 256. crc16 is CRC-16/CCITT-FALSE
+// (poly 0x1021, init 0xffff) over type, seq and payload, sent big endian.
+#define ECHO_PAYLOAD_MAX 250
+#define ECHO_RAW_MAX (2 + ECHO_PAYLOAD_MAX + 2)                // Decoded frame
+#define ECHO_WIRE_MAX (ECHO_RAW_MAX + ECHO_RAW_MAX / 254 + 2) // COBS overhead and delimiter
+
+// Frame types
+#define ECHO_TYPE_HELLO  0x01 // Peer (re)started, its seq restarts. No payload
+#define ECHO_TYPE_BUTTON 0x02 // Peer to host: 1 byte, 1 pressed, 0 released
+#define ECHO_TYPE_LED    0x03 // Host to peer: 1 byte, 1 on, 0 off. Buttons are sent while on
+#define ECHO_TYPE_PING   0x04 // Either way: answered with a PONG carrying the same payload
+#define ECHO_TYPE_PONG   0x05
+
+// read() returns whole frames, each a struct echo_msg followed by len payload bytes, as
+// many as fit. The buffer must hold at least ECHO_READ_MIN bytes. Frames with a bad CRC
+// or COBS encoding are dropped in the driver. Blocks until a frame arrives unless
+// O_NONBLOCK; poll() reports EPOLLIN while frames are queued.
+#define ECHO_READ_MIN (sizeof(struct echo_msg) + ECHO_PAYLOAD_MAX)
+
+struct echo_msg {
+    __u64 timestamp_ns; // CLOCK_MONOTONIC, when the frame's delimiter arrived
+    __u16 len;          // Payload bytes following the header
+    __u8 type;          // ECHO_TYPE_*
+    __u8 seq;
+    __u32 lost;         // Frames missing (sequence gap) right before this one
+};
+
+// write() sends one frame: the type byte followed by at most ECHO_PAYLOAD_MAX payload
+// bytes. The driver adds seq and CRC and queues it in one piece. poll() reports EPOLLOUT
+// while a frame of any size fits.
+#define ECHO_WRITE_MAX (1 + ECHO_PAYLOAD_MAX)
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef FRAME_H
+#define FRAME_H
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/crc-itu-t.h>
+
+#include "echo_uapi.h"
+
+// COBS (consistent overhead byte stuffing) removes every 0 from a frame, so 0 can delimit
+// frames: a receiver that lost sync just waits for the next 0. Each block starts with a
+// code byte: code - 1 data bytes follow, then an implied 0 unless code is 0xff or it is
+// the last block.
+
+// Encode len bytes from src into dst (at least len + len / 254 + 1 bytes), no delimiter
+static size_t cobs_encode(const u8 *src, size_t len, u8 *dst)
+{
+    size_t code_pos = 0, out = 1, i;
+    u8 code = 1;
+
+    for (i = 0; i < len; i++) {
+        if (src[i]) {
+            dst[out++] = src[i];
+            code++;
+        }
+        if (!src[i] || code == 0xff) {
+            dst[code_pos] = code;
+            code = 1;
+            code_pos = out++;
+        }
+    }
+    dst[code_pos] = code;
+    return out;
+}
+
+// Decode one frame (delimiter stripped) in place, the output never overtakes the input.
+// Returns the decoded length or -EINVAL for a block running past the end.
+static int cobs_decode(u8 *buf, size_t len)
+{
+    size_t in = 0, out = 0;
+    u8 code;
+
+    while (in < len) {
+        code = buf[in++];
+        if (!code || in + code - 1 > len)
+            return -EINVAL;
+        memmove(buf + out, buf + in, code - 1);
+        out += code - 1;
+        in += code - 1;
+        if (code != 0xff && in < len)
+            buf[out++] = 0;
+    }
+    return out;
+}
+
+// Build the wire form of a frame in wire (ECHO_WIRE_MAX bytes), returns its length
+static size_t frame_encode(u8 type, u8 seq, const u8 *payload, size_t len, u8 *wire)
+{
+    u8 raw[ECHO_RAW_MAX];
+    size_t n;
+    u16 crc;
+
+    raw[0] = type;
+    raw[1] = seq;
+    memcpy(raw + 2, payload, len);
+    crc = crc_itu_t(0xffff, raw, len + 2);
+    raw[len + 2] = crc >> 8;
+    raw[len + 3] = crc & 0xff;
+
+    n = cobs_encode(raw, len + 4, wire);
+    wire[n++] = 0;
+    return n;
+}
+
+// Check a decoded frame, true if the length and CRC are fine
+static bool frame_valid(const u8 *raw, int len)
+{
+    return len >= 4 && len <= ECHO_RAW_MAX &&
+           crc_itu_t(0xffff, raw, len - 2) == ((raw[len - 2] << 8) | raw[len - 1]);
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+
+#include "../echo_uapi.h"
+
+// Round-trip latency and sustained throughput through the PING/PONG echo path.
+// Usage: bench [/dev/echo-serial0-0] [count] [window]
+// The peer is the Arduino sketch, or a jumper from TXD to RXD with nothing attached: the
+// driver then answers its own PINGs, so each round trip crosses the line twice and PINGs
+// and PONGs share one direction (expect half the throughput).
+// Change the rate with: echo 1000000 > /sys/class/misc/echo-serial0-0/device/baudrate
+#define TIMEOUT_MS 1000
+
+// While the Uno writes one PONG, the PINGs behind it wait in its 64-byte serial RX ring;
+// anything past that is dropped. The throughput window is clamped to what fits there.
+#define PEER_RX_BUF 64
+#define PING_WIRE (ECHO_PAYLOAD_MAX + 6) // 4 bytes of frame overhead + COBS + delimiter
+#define WINDOW_MAX (1 + PEER_RX_BUF / PING_WIRE)
+
+static int fd;
+static char buf[64 * ECHO_READ_MIN];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// PING with id in the first 4 payload bytes, padded to len
+static int send_ping(uint32_t id, int len)
+{
+    uint8_t frame[ECHO_WRITE_MAX];
+
+    memset(frame, 0x55, sizeof(frame));
+    frame[0] = ECHO_TYPE_PING;
+    memcpy(frame + 1, &id, sizeof(id));
+    if (write(fd, frame, 1 + len) != 1 + len) {
+        perror("Failed to send PING");
+        return -1;
+    }
+    return 0;
+}
+
+// Wait for frames, calls got(id, kernel arrival stamp) for each PONG. Returns how many frames
+// arrived, 0 on timeout.
+static int recv_pongs(void (*got)(uint32_t id, uint64_t ts))
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    ssize_t bytes_read;
+    int frames = 0;
+
+    if (poll(&pfd, 1, TIMEOUT_MS) <= 0)
+        return 0;
+    bytes_read = read(fd, buf, sizeof(buf));
+    if (bytes_read == -1) {
+        perror("Failed to read from echo device");
+        return -1;
+    }
+    for (ssize_t off = 0; off < bytes_read;) {
+        struct echo_msg msg;
+        uint32_t id;
+
+        memcpy(&msg, buf + off, sizeof(msg));
+        if (msg.type == ECHO_TYPE_PONG && msg.len >= sizeof(id)) {
+            memcpy(&id, buf + off + sizeof(msg), sizeof(id));
+            got(id, msg.timestamp_ns);
+        }
+        off += sizeof(msg) + msg.len;
+        frames++;
+    }
+    return frames;
+}
+
+static uint64_t *sent_ns, *rtt_ns;
+static uint8_t *in_flight; // Throughput PINGs not yet answered or given up, by id - count
+static uint32_t expect;
+static int count, answered;
+
+static void got_latency(uint32_t id, uint64_t ts)
+{
+    if (id == expect && !rtt_ns[id]) {
+        rtt_ns[id] = ts - sent_ns[id];
+        answered++;
+    }
+}
+
+// Only PONGs still outstanding count: stale ones from the latency run or ones that
+// turn up after their PING was counted lost would inflate the rate
+static void got_throughput(uint32_t id, uint64_t ts)
+{
+    (void)ts;
+    if (id >= (uint32_t)count && id - count < (uint32_t)count && in_flight[id - count]) {
+        in_flight[id - count] = 0;
+        answered++;
+    }
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static unsigned int read_baudrate(const char *path)
+{
+    const char *name = strrchr(path, '/');
+    char attr[256];
+    unsigned int baud = 0;
+    FILE *f;
+
+    // /dev/echo-X -> /sys/class/misc/echo-X/device/baudrate
+    snprintf(attr, sizeof(attr), "/sys/class/misc/%s/device/baudrate", name ? name + 1 : path);
+    f = fopen(attr, "r");
+    if (f) {
+        if (fscanf(f, "%u", &baud) != 1)
+            baud = 0;
+        fclose(f);
+    }
+    return baud;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "/dev/" ECHO_DEV_PREFIX "serial0-0";
+    int window = argc > 3 ? atoi(argv[3]) : WINDOW_MAX;
+    unsigned int baud = read_baudrate(path);
+    uint64_t start, elapsed;
+    int sent, n, lost = 0;
+
+    count = argc > 2 ? atoi(argv[2]) : 1000;
+
+    fd = open(path, O_RDWR);
+    if (fd == -1) {
+        perror("Failed to open echo device");
+        return -1;
+    }
+    sent_ns = calloc(count, sizeof(*sent_ns));
+    rtt_ns = calloc(count, sizeof(*rtt_ns));
+    in_flight = calloc(count, sizeof(*in_flight));
+    if (!sent_ns || !rtt_ns || !in_flight || count <= 0 || window <= 0)
+        return -1;
+    if (window > WINDOW_MAX) {
+        fprintf(stderr, "Window %d overruns the peer's RX buffer, using %d\n", window, WINDOW_MAX);
+        window = WINDOW_MAX;
+    }
+    while (recv_pongs(got_throughput) > 0) // Leftovers of an earlier run
+        ;
+
+    // Latency: one small PING at a time, write() to the driver's arrival stamp of the PONG
+    answered = 0;
+    for (int i = 0; i < count; i++) {
+        expect = i;
+        sent_ns[i] = now_ns();
+        if (send_ping(i, 8))
+            return -1;
+        do {
+            n = recv_pongs(got_latency);
+        } while (n > 0 && !rtt_ns[i]);
+        if (n < 0)
+            return -1;
+        if (!rtt_ns[i])
+            lost++;
+    }
+    n = 0;
+    for (int i = 0; i < count; i++)
+        if (rtt_ns[i])
+            rtt_ns[n++] = rtt_ns[i];
+    qsort(rtt_ns, n, sizeof(*rtt_ns), cmp_u64);
+    printf("Latency, %d PINGs of 8 bytes at %u baud, %d lost\n", count, baud, lost);
+    if (n)
+        printf("  min %.1f us, median %.1f us, p99 %.1f us, max %.1f us\n",
+               rtt_ns[0] / 1e3, rtt_ns[n / 2] / 1e3, rtt_ns[n * 99 / 100] / 1e3, rtt_ns[n - 1] / 1e3);
+
+    // Throughput: full PINGs, window of them in flight. Ids follow the latency run's.
+    answered = 0;
+    sent = 0;
+    lost = 0;
+    start = now_ns();
+    while (answered + lost < count) {
+        while (sent < count && sent - answered - lost < window) {
+            in_flight[sent] = 1;
+            if (send_ping(count + sent++, ECHO_PAYLOAD_MAX))
+                return -1;
+        }
+        n = recv_pongs(got_throughput);
+        if (n < 0)
+            return -1;
+        if (!n) { // Nothing for TIMEOUT_MS: whatever is in flight is gone
+            memset(in_flight, 0, count);
+            lost = sent - answered;
+        }
+    }
+    elapsed = now_ns() - start;
+    printf("Throughput, %d PINGs of %d bytes, window %d, %d lost\n", count, ECHO_PAYLOAD_MAX,
+           window, lost);
+    printf("  %.0f frames/s, %.1f kB/s payload each way", answered / (elapsed / 1e9),
+           answered * (double)ECHO_PAYLOAD_MAX / (elapsed / 1e6));
+    if (baud) // 10 bits per byte (8N1), frame overhead is 4 bytes + COBS + delimiter
+        printf(", %.0f%% of the line", 100.0 * answered * PING_WIRE * 10 /
+               (elapsed / 1e9) / baud);
+    printf("\n");
+
+    free(sent_ns);
+    free(rtt_ns);
+    free(in_flight);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <poll.h>
+
+#include "../echo_uapi.h"
+
+// Turns the LED on, prints button frames with their receive timestamps, turns it off.
+// Usage: read_msgs [/dev/echo-serial0-0] [count]
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "/dev/" ECHO_DEV_PREFIX "serial0-0";
+    int count = argc > 2 ? atoi(argv[2]) : 10;
+    char buf[16 * ECHO_READ_MIN];
+    uint8_t led_on[] = { ECHO_TYPE_LED, 1 };
+    uint8_t led_off[] = { ECHO_TYPE_LED, 0 };
+    struct pollfd pfd;
+    int got = 0;
+
+    int fd = open(path, O_RDWR);
+    if (fd == -1) {
+        perror("Failed to open echo device");
+        return -1;
+    }
+    if (write(fd, led_on, sizeof(led_on)) != sizeof(led_on)) {
+        perror("Failed to turn the LED on");
+        close(fd);
+        return -1;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (got < count) {
+        if (poll(&pfd, 1, 10000) <= 0) {
+            printf("No frame for 10 s\n");
+            break;
+        }
+        ssize_t bytes_read = read(fd, buf, sizeof(buf));
+        if (bytes_read == -1) {
+            perror("Failed to read from echo device");
+            break;
+        }
+        // Whole frames, each a header followed by its payload
+        for (ssize_t off = 0; off < bytes_read; got++) {
+            struct echo_msg msg;
+            const uint8_t *payload = (uint8_t *)buf + off + sizeof(msg);
+
+            memcpy(&msg, buf + off, sizeof(msg));
+            printf("%llu.%09llu seq %3u ", (unsigned long long)(msg.timestamp_ns / 1000000000),
+                   (unsigned long long)(msg.timestamp_ns % 1000000000), msg.seq);
+            if (msg.type == ECHO_TYPE_BUTTON && msg.len == 1)
+                printf("%s", payload[0] ? "PRESSED" : "RELEASED");
+            else if (msg.type == ECHO_TYPE_HELLO)
+                printf("HELLO (peer restarted)");
+            else
+                printf("type %u, %u bytes", msg.type, msg.len);
+            if (msg.lost)
+                printf(" (%u frames lost before)", msg.lost);
+            printf("\n");
+            off += sizeof(msg) + msg.len;
+        }
+    }
+
+    if (write(fd, led_off, sizeof(led_off)) != sizeof(led_off))
+        perror("Failed to turn the LED off");
+    close(fd);
+    return 0;
+}
@@ -1,43 +1,140 @@
+#include <util/crc16.h>
+
+// Frames both ways: COBS(type, seq, payload, crc16) followed by a 0 delimiter.
+// Mirrors echo_uapi.h: crc16 is CRC-16/CCITT-FALSE over type, seq and payload, big endian.
+const uint8_t TYPE_HELLO = 0x01;  // Sent at boot, the Pi restarts its sequence check
+const uint8_t TYPE_BUTTON = 0x02; // 1 pressed, 0 released
+const uint8_t TYPE_LED = 0x03;    // From the Pi: 1 on, 0 off
+const uint8_t TYPE_PING = 0x04;   // Answered with a PONG carrying the same payload
+const uint8_t TYPE_PONG = 0x05;
+
+const int PAYLOAD_MAX = 250;
+const int RAW_MAX = PAYLOAD_MAX + 4;
+const int WIRE_MAX = RAW_MAX + RAW_MAX / 254 + 2;
+
+const long baudRate = 115200; // Must match current-speed in uart_Overlay.dts
+
 const int buttonPin = 2;     // Pushbutton pin
 const int ledPin = 13;       // Built-in LED pin
 
 bool ledState = false;
 bool lastButtonState = LOW;
+unsigned long lastButtonCheck = 0;
+
+uint8_t txSeq = 0;
+uint8_t txWire[WIRE_MAX];
+uint8_t rxFrame[WIRE_MAX];
+int rxLen = 0;
+bool rxOverflow = false; // Frame too long, wait for the next delimiter
+
+uint16_t crc16(const uint8_t *data, int len) {
+  uint16_t crc = 0xffff;
+  for (int i = 0; i < len; i++)
+    crc = _crc_xmodem_update(crc, data[i]); // Poly 0x1021, not reflected
+  return crc;
+}
+
+// Each block: code byte, code - 1 data bytes, then an implied 0 unless code is 0xff
+int cobsEncode(const uint8_t *src, int len, uint8_t *dst) {
+  int codePos = 0, out = 1;
+  uint8_t code = 1;
+
+  for (int i = 0; i < len; i++) {
+    if (src[i]) {
+      dst[out++] = src[i];
+      code++;
+    }
+    if (!src[i] || code == 0xff) {
+      dst[codePos] = code;
+      code = 1;
+      codePos = out++;
+    }
+  }
+  dst[codePos] = code;
+  return out;
+}
+
+// In place, returns the decoded length or -1
+int cobsDecode(uint8_t *buf, int len) {
+  int in = 0, out = 0;
+
+  while (in < len) {
+    uint8_t code = buf[in++];
+    if (!code || in + code - 1 > len)
+      return -1;
+    memmove(buf + out, buf + in, code - 1);
+    out += code - 1;
+    in += code - 1;
+    if (code != 0xff && in < len)
+      buf[out++] = 0;
+  }
+  return out;
+}
+
+void sendFrame(uint8_t type, const uint8_t *payload, int len) {
+  uint8_t raw[RAW_MAX];
+
+  raw[0] = type;
+  raw[1] = txSeq++;
+  memcpy(raw + 2, payload, len);
+  uint16_t crc = crc16(raw, len + 2);
+  raw[len + 2] = crc >> 8;
+  raw[len + 3] = crc & 0xff;
+
+  int n = cobsEncode(raw, len + 4, txWire);
+  txWire[n++] = 0;
+  Serial.write(txWire, n);
+}
+
+// A decoded frame, corrupt ones are ignored
+void handleFrame(uint8_t *raw, int len) {
+  if (len < 4 || crc16(raw, len - 2) != ((raw[len - 2] << 8) | raw[len - 1]))
+    return;
+
+  if (raw[0] == TYPE_LED && len == 5) {
+    ledState = raw[2];
+    digitalWrite(ledPin, ledState ? HIGH : LOW);
+  } else if (raw[0] == TYPE_PING) {
+    sendFrame(TYPE_PONG, raw + 2, len - 4);
+  }
+}
 
 void setup() {
   pinMode(buttonPin, INPUT);
   pinMode(ledPin, OUTPUT);
-  Serial.begin(115200);
+  Serial.begin(baudRate);
   while (!Serial);  // Wait for Serial to be ready
+
+  Serial.write((uint8_t)0); // Ends whatever the Pi received before, then announce the restart
+  sendFrame(TYPE_HELLO, NULL, 0);
 }
 
 void loop() {
-  // Check for message from Raspberry Pi
-  if (Serial.available() > 0) {
-    String input = Serial.readStringUntil('\n');
-    input.trim();
-
-    if (input == "ON") {
-      ledState = true;
-      digitalWrite(ledPin, HIGH);
-    } else if (input == "OFF") {
-      ledState = false;
-      digitalWrite(ledPin, LOW);
+  // Frames from the Raspberry Pi, 0 ends each one
+  while (Serial.available() > 0) {
+    uint8_t c = Serial.read();
+    if (c) {
+      if (rxLen < WIRE_MAX)
+        rxFrame[rxLen++] = c;
+      else
+        rxOverflow = true;
+      continue;
     }
+    if (rxLen && !rxOverflow)
+      handleFrame(rxFrame, cobsDecode(rxFrame, rxLen));
+    rxLen = 0;
+    rxOverflow = false;
   }
 
-  // Only send button state if LED is on
-  if (ledState) {
+  // Only send button state if LED is on. Checked every 50 ms (debounce) without
+  // blocking, so PINGs are answered right away
+  if (ledState && millis() - lastButtonCheck >= 50) {
+    lastButtonCheck = millis();
     bool currentButtonState = digitalRead(buttonPin);
     if (currentButtonState != lastButtonState) {
       lastButtonState = currentButtonState;
-      if (currentButtonState == HIGH) {
-        Serial.println("PRESSED");
-      } else {
-        Serial.println("RELEASED");
-      }
+      uint8_t pressed = currentButtonState == HIGH;
+      sendFrame(TYPE_BUTTON, &pressed, 1);
     }
   }
-
-  delay(50); // Debounce & pacing
 }